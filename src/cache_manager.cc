@@ -8,10 +8,13 @@
 #include <loguru/loguru.hpp>
 
 #include <algorithm>
+#include <atomic>
 #include <unordered_map>
 
 namespace {
 
+std::atomic<size_t> g_loaded_cache_count{0};
+
 // Manages loading caches from file paths for the indexer process.
 struct RealCacheManager : ICacheManager {
   explicit RealCacheManager() {}
@@ -114,7 +117,9 @@ std::shared_ptr<ICacheManager> ICacheManager::MakeFake(
   return std::make_shared<FakeCacheManager>(entries);
 }
 
-ICacheManager::~ICacheManager() = default;
+ICacheManager::~ICacheManager() {
+  g_loaded_cache_count -= caches_.size();
+}
 
 IndexFile* ICacheManager::TryLoad(const std::string& path) {
   auto it = caches_.find(path);
@@ -126,6 +131,7 @@ IndexFile* ICacheManager::TryLoad(const std::string& path) {
     return nullptr;
 
   caches_[path] = std::move(cache);
+  ++g_loaded_cache_count;
   return caches_[path].get();
 }
 
@@ -135,6 +141,7 @@ std::unique_ptr<IndexFile> ICacheManager::TryTakeOrLoad(
   if (it != caches_.end()) {
     auto result = std::move(it->second);
     caches_.erase(it);
+    --g_loaded_cache_count;
     return result;
   }
 
@@ -147,6 +154,11 @@ std::unique_ptr<IndexFile> ICacheManager::TakeOrLoad(const std::string& path) {
   return result;
 }
 
+// static
+size_t ICacheManager::LoadedCacheCount() {
+  return g_loaded_cache_count;
+}
+
 void ICacheManager::IterateLoadedCaches(std::function<void(IndexFile*)> fn) {
   for (const auto& cache : caches_) {
     assert(cache.second);
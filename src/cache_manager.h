@@ -44,6 +44,10 @@ struct ICacheManager {
   // Iterate over all loaded caches.
   void IterateLoadedCaches(std::function<void(IndexFile*)> fn);
 
+  // Number of caches which are loaded but not taken yet, across all cache
+  // managers.
+  static size_t LoadedCacheCount();
+
  protected:
   virtual std::unique_ptr<IndexFile> RawCacheLoad(const std::string& path) = 0;
   std::unordered_map<std::string, std::unique_ptr<IndexFile>> caches_;
@@ -395,7 +395,7 @@ void TryEnsureDocumentParsed(ClangCompleteManager* manager,
   if (*tu)
     return;
 
-  std::vector<std::string> args = session->file.args;
+  std::vector<std::string> args = session->file.args.ToVector();
 
   // -fspell-checking enables FixIts for, ie, misspelled types.
   if (!AnyStartsWith(args, "-fno-spell-checking") &&
@@ -862,3 +862,27 @@ void ClangCompleteManager::FlushAllSessions() {
   preloaded_sessions_.Clear();
   completion_sessions_.Clear();
 }
+
+void ClangCompleteManager::GetMemoryUsage(size_t* sessions, size_t* bytes) {
+  *sessions = 0;
+  *bytes = 0;
+  auto add_tu = [&](CompletionSession::Tu& tu) {
+    std::unique_lock<std::mutex> lock(tu.lock, std::try_to_lock);
+    if (!lock || !tu.tu)
+      return;
+    CXTUResourceUsage usage = clang_getCXTUResourceUsage(tu.tu->cx_tu);
+    for (unsigned i = 0; i < usage.numEntries; ++i)
+      *bytes += usage.entries[i].amount;
+    clang_disposeCXTUResourceUsage(usage);
+  };
+  auto add_session = [&](const std::shared_ptr<CompletionSession>& session) {
+    ++*sessions;
+    add_tu(session->completion);
+    add_tu(session->diagnostics);
+    return true;
+  };
+
+  std::lock_guard<std::mutex> lock(sessions_lock_);
+  preloaded_sessions_.IterateValues(add_session);
+  completion_sessions_.IterateValues(add_session);
+}
@@ -116,6 +116,11 @@ struct ClangCompleteManager {
   // Flushes all saved sessions
   void FlushAllSessions(void);
 
+  // Returns the number of cached sessions and the memory libclang reports for
+  // their translation units. Translation units which are busy are skipped
+  // rather than waited for.
+  void GetMemoryUsage(size_t* sessions, size_t* bytes);
+
   // TODO: make these configurable.
   const int kMaxPreloadedSessions = 10;
   const int kMaxCompletionSessions = 5;
@@ -8,6 +8,9 @@
 #include <loguru.hpp>
 #include <pugixml.hpp>
 
+#include <algorithm>
+#include <mutex>
+
 namespace {
 
 struct Replacement {
@@ -45,15 +48,45 @@ std::vector<Replacement> ParseClangFormatReplacements(const std::string& xml) {
   return result;
 }
 
+// Converts offsets to positions. clang-format reports replacements ordered by
+// offset, so the document is scanned once instead of from the start for every
+// replacement, which matters for small ranges at the end of large files.
+class OffsetToPosition {
+ public:
+  explicit OffsetToPosition(std::string_view content) : content_(content) {}
+
+  lsPosition Get(int offset) {
+    if (offset < offset_) {
+      offset_ = 0;
+      position_ = lsPosition();
+    }
+    int end = std::min(offset, (int)content_.size());
+    for (; offset_ < end; ++offset_) {
+      if (content_[offset_] == '\n') {
+        position_.line++;
+        position_.character = 0;
+      } else {
+        position_.character++;
+      }
+    }
+    return position_;
+  }
+
+ private:
+  std::string_view content_;
+  int offset_ = 0;
+  lsPosition position_;
+};
+
 std::vector<lsTextEdit> ConvertReplacementsToTextEdits(
     const std::string& document,
     const std::vector<Replacement>& replacements) {
   std::vector<lsTextEdit> edits;
+  OffsetToPosition positions(document);
   for (const Replacement& replacement : replacements) {
     lsTextEdit edit;
-    edit.range.start = GetPositionForOffset(replacement.offset, document);
-    edit.range.end =
-        GetPositionForOffset(replacement.offset + replacement.length, document);
+    edit.range.start = positions.Get(replacement.offset);
+    edit.range.end = positions.Get(replacement.offset + replacement.length);
     edit.newText = replacement.text;
     LOG_S(INFO) << "Text edit from " << edit.range.start.ToString() << " to "
                 << edit.range.end.ToString() << " with text |" << edit.newText
@@ -71,9 +104,23 @@ std::vector<lsTextEdit> RunClangFormat(const std::string& filename,
                                        optional<int> end_offset) {
   assert(start_offset.has_value() == end_offset.has_value());
 
-  std::vector<std::string> clang_format_drivers = {
-      GetExecutablePathNextToCqueryBinary("cquery-clang-format"),
-      "clang-format"};
+  // Remember which driver works, so that a missing cquery-clang-format is not
+  // spawned again before every request.
+  static std::mutex driver_mutex;
+  static optional<std::string> working_driver;
+
+  std::vector<std::string> clang_format_drivers;
+  {
+    std::lock_guard<std::mutex> lock(driver_mutex);
+    if (working_driver)
+      clang_format_drivers.push_back(*working_driver);
+  }
+  for (const std::string& driver : std::vector<std::string>{
+           GetExecutablePathNextToCqueryBinary("cquery-clang-format"),
+           "clang-format"}) {
+    if (!ContainsValue(clang_format_drivers, driver))
+      clang_format_drivers.push_back(driver);
+  }
 
   for (const std::string& clang_format_driver : clang_format_drivers) {
     std::vector<std::string> args = {clang_format_driver,
@@ -88,6 +135,10 @@ std::vector<lsTextEdit> RunClangFormat(const std::string& filename,
     optional<std::string> output = RunExecutable(args, file_contents);
     if (!output || output->empty())
       continue;
+    {
+      std::lock_guard<std::mutex> lock(driver_mutex);
+      working_driver = clang_format_driver;
+    }
     // Do not check if replacements is empty, since that may happen if there are
     // no formatting changes.
     std::vector<Replacement> replacements =
@@ -127,6 +178,24 @@ TEST_SUITE("clang-format output parsing") {
     c(replacements[4], 1, 2, " \t ");
   }
 
+  TEST_CASE("text edits") {
+    std::string document = "a\nbc\n\nd";
+    std::vector<lsTextEdit> edits = ConvertReplacementsToTextEdits(
+        document, {{1, 1, " "}, {3, 2, ""}, {0, 0, "x"}, {8, 4, ""}});
+
+    REQUIRE(edits.size() == 4);
+    REQUIRE(edits[0].range.start == lsPosition(0, 1));
+    REQUIRE(edits[0].range.end == lsPosition(1, 0));
+    REQUIRE(edits[1].range.start == lsPosition(1, 1));
+    REQUIRE(edits[1].range.end == lsPosition(2, 0));
+    // Offsets going backwards rescan from the start.
+    REQUIRE(edits[2].range.start == lsPosition(0, 0));
+    REQUIRE(edits[2].range.end == lsPosition(0, 0));
+    // Offsets past the end clamp to the end of the document.
+    REQUIRE(edits[3].range.start == lsPosition(3, 1));
+    REQUIRE(edits[3].range.end == lsPosition(3, 1));
+  }
+
   TEST_CASE("no replacements") {
     std::vector<Replacement> replacements = ParseClangFormatReplacements(R"(
       <?xml version='1.0'?>
@@ -773,16 +773,40 @@ IndexId::Var IndexFile::ToVarId(Usr usr) {
   return id;
 }
 
-IndexId::Type IndexFile::ToTypeId(const CXCursor& cursor) {
-  return ToTypeId(ClangCursor(cursor).get_usr_hash());
+namespace {
+
+template <typename Id>
+Id ToIdFromCursor(IndexFile* file,
+                  std::unordered_map<ClangCursor, Id>& cursor_to_id,
+                  Id (IndexFile::*to_id)(Usr),
+                  const CXCursor& cursor,
+                  const char* usr) {
+  // Redeclarations share the canonical cursor, so they share the entry.
+  ClangCursor canonical = clang_getCanonicalCursor(cursor);
+  auto it = cursor_to_id.find(canonical);
+  if (it != cursor_to_id.end())
+    return it->second;
+
+  Id id = (file->*to_id)(usr ? HashUsr(usr) : canonical.get_usr_hash());
+  cursor_to_id[canonical] = id;
+  return id;
 }
 
-IndexId::Func IndexFile::ToFuncId(const CXCursor& cursor) {
-  return ToFuncId(ClangCursor(cursor).get_usr_hash());
+}  // namespace
+
+IndexId::Type IndexFile::ToTypeId(const CXCursor& cursor, const char* usr) {
+  IndexId::Type (IndexFile::*to_id)(Usr) = &IndexFile::ToTypeId;
+  return ToIdFromCursor(this, cursor_to_type_id, to_id, cursor, usr);
 }
 
-IndexId::Var IndexFile::ToVarId(const CXCursor& cursor) {
-  return ToVarId(ClangCursor(cursor).get_usr_hash());
+IndexId::Func IndexFile::ToFuncId(const CXCursor& cursor, const char* usr) {
+  IndexId::Func (IndexFile::*to_id)(Usr) = &IndexFile::ToFuncId;
+  return ToIdFromCursor(this, cursor_to_func_id, to_id, cursor, usr);
+}
+
+IndexId::Var IndexFile::ToVarId(const CXCursor& cursor, const char* usr) {
+  IndexId::Var (IndexFile::*to_id)(Usr) = &IndexFile::ToVarId;
+  return ToIdFromCursor(this, cursor_to_var_id, to_id, cursor, usr);
 }
 
 IndexType* IndexFile::Resolve(IndexId::Type id) {
@@ -1320,7 +1344,7 @@ ClangCursor::VisitResult TemplateVisitor(ClangCursor cursor,
     case CXCursor_DeclRefExpr: {
       ClangCursor ref_cursor = clang_getCursorReferenced(cursor.cx_cursor);
       if (ref_cursor.get_kind() == CXCursor_NonTypeTemplateParameter) {
-        IndexId::Var ref_var_id = db->ToVarId(ref_cursor.get_usr_hash());
+        IndexId::Var ref_var_id = db->ToVarId(ref_cursor.cx_cursor);
         IndexVar* ref_var = db->Resolve(ref_var_id);
         if (ref_var->def.detailed_name.empty()) {
           ClangCursor sem_parent = ref_cursor.get_semantic_parent();
@@ -1363,7 +1387,7 @@ ClangCursor::VisitResult TemplateVisitor(ClangCursor cursor,
             break;
           case CXCursor_FunctionDecl:
           case CXCursor_FunctionTemplate: {
-            IndexId::Func called_id = db->ToFuncId(overloaded.get_usr_hash());
+            IndexId::Func called_id = db->ToFuncId(overloaded.cx_cursor);
             OnIndexReference_Function(db, cursor.get_spell(), data->container,
                                       called_id, Role::Call);
             break;
@@ -1375,7 +1399,7 @@ ClangCursor::VisitResult TemplateVisitor(ClangCursor cursor,
     case CXCursor_TemplateRef: {
       ClangCursor ref_cursor = clang_getCursorReferenced(cursor.cx_cursor);
       if (ref_cursor.get_kind() == CXCursor_TemplateTemplateParameter) {
-        IndexId::Type ref_type_id = db->ToTypeId(ref_cursor.get_usr_hash());
+        IndexId::Type ref_type_id = db->ToTypeId(ref_cursor.cx_cursor);
         IndexType* ref_type = db->Resolve(ref_type_id);
         // TODO It seems difficult to get references to template template
         // parameters.
@@ -1409,7 +1433,7 @@ ClangCursor::VisitResult TemplateVisitor(ClangCursor cursor,
     case CXCursor_TypeRef: {
       ClangCursor ref_cursor = clang_getCursorReferenced(cursor.cx_cursor);
       if (ref_cursor.get_kind() == CXCursor_TemplateTypeParameter) {
-        IndexId::Type ref_type_id = db->ToTypeId(ref_cursor.get_usr_hash());
+        IndexId::Type ref_type_id = db->ToTypeId(ref_cursor.cx_cursor);
         IndexType* ref_type = db->Resolve(ref_type_id);
         // TODO It seems difficult to get a FunctionTemplate's template
         // parameters.
@@ -1532,7 +1556,8 @@ void OnIndexDeclaration(CXClientData client_data, const CXIdxDeclInfo* decl) {
 
     case CXIdxEntity_CXXNamespace: {
       Range spell = cursor.get_spell();
-      IndexId::Type ns_id = db->ToTypeId(HashUsr(decl->entityInfo->USR));
+      IndexId::Type ns_id =
+          db->ToTypeId(decl->entityInfo->cursor, decl->entityInfo->USR);
       IndexType* ns = db->Resolve(ns_id);
       ns->def.kind = GetSymbolKind(decl->entityInfo->kind);
       if (ns->def.detailed_name.empty()) {
@@ -1542,8 +1567,8 @@ void OnIndexDeclaration(CXClientData client_data, const CXIdxDeclInfo* decl) {
         ns->def.extent =
             SetUse(db, cursor.get_extent(), lex_parent, Role::None);
         if (decl->semanticContainer) {
-          IndexId::Type parent_id = db->ToTypeId(
-              ClangCursor(decl->semanticContainer->cursor).get_usr_hash());
+          IndexId::Type parent_id =
+              db->ToTypeId(decl->semanticContainer->cursor);
           db->Resolve(parent_id)->derived.push_back(ns_id);
           // |ns| may be invalidated.
           ns = db->Resolve(ns_id);
@@ -1570,7 +1595,8 @@ void OnIndexDeclaration(CXClientData client_data, const CXIdxDeclInfo* decl) {
       if (cursor != cursor.template_specialization_to_template_definition())
         break;
 
-      IndexId::Var var_id = db->ToVarId(HashUsr(decl->entityInfo->USR));
+      IndexId::Var var_id =
+          db->ToVarId(decl->entityInfo->cursor, decl->entityInfo->USR);
       IndexVar* var = db->Resolve(var_id);
 
       // TODO: Eventually run with this if. Right now I want to iron out bugs
@@ -1759,7 +1785,7 @@ void OnIndexDeclaration(CXClientData client_data, const CXIdxDeclInfo* decl) {
             ClangCursor parent =
                 ClangCursor(overridden[i])
                     .template_specialization_to_template_definition();
-            IndexId::Func parent_id = db->ToFuncId(parent.get_usr_hash());
+            IndexId::Func parent_id = db->ToFuncId(parent.cx_cursor);
             IndexFunc* parent_def = db->Resolve(parent_id);
             func = db->Resolve(func_id);  // ToFuncId invalidated func_def
 
@@ -1781,7 +1807,8 @@ void OnIndexDeclaration(CXClientData client_data, const CXIdxDeclInfo* decl) {
       optional<IndexId::Type> alias_of = AddDeclTypeUsages(
           db, cursor, nullopt, decl->semanticContainer, decl->lexicalContainer);
 
-      IndexId::Type type_id = db->ToTypeId(HashUsr(decl->entityInfo->USR));
+      IndexId::Type type_id =
+          db->ToTypeId(decl->entityInfo->cursor, decl->entityInfo->USR);
       IndexType* type = db->Resolve(type_id);
 
       if (alias_of)
@@ -1832,7 +1859,8 @@ void OnIndexDeclaration(CXClientData client_data, const CXIdxDeclInfo* decl) {
     case CXIdxEntity_CXXClass: {
       Range spell = cursor.get_spell();
 
-      IndexId::Type type_id = db->ToTypeId(HashUsr(decl->entityInfo->USR));
+      IndexId::Type type_id =
+          db->ToTypeId(decl->entityInfo->cursor, decl->entityInfo->USR);
       IndexType* type = db->Resolve(type_id);
 
       // TODO: Eventually run with this if. Right now I want to iron out bugs
@@ -1875,7 +1903,7 @@ void OnIndexDeclaration(CXClientData client_data, const CXIdxDeclInfo* decl) {
           // TODO Use a different dimension
           ClangCursor origin_cursor =
               cursor.template_specialization_to_template_definition();
-          IndexId::Type origin_id = db->ToTypeId(origin_cursor.get_usr_hash());
+          IndexId::Type origin_id = db->ToTypeId(origin_cursor.cx_cursor);
           IndexType* origin = db->Resolve(origin_id);
           // |type| may be invalidated.
           type = db->Resolve(type_id);
@@ -2004,13 +2032,13 @@ void OnIndexReference(CXClientData client_data, const CXIdxEntityRefInfo* ref) {
       break;
 
     case CXIdxEntity_CXXNamespace: {
-      IndexType* ns = db->Resolve(db->ToTypeId(referenced.get_usr_hash()));
+      IndexType* ns = db->Resolve(db->ToTypeId(referenced.cx_cursor));
       AddRef(db, ns->uses, cursor.get_spell(), FromContainer(ref->container));
       break;
     }
 
     case CXIdxEntity_CXXNamespaceAlias: {
-      IndexType* ns = db->Resolve(db->ToTypeId(referenced.get_usr_hash()));
+      IndexType* ns = db->Resolve(db->ToTypeId(referenced.cx_cursor));
       AddRef(db, ns->uses, cursor.get_spell(), FromContainer(ref->container));
       if (!ns->def.spell) {
         ClangCursor sem_parent = referenced.get_semantic_parent();
@@ -2038,7 +2066,7 @@ void OnIndexReference(CXClientData client_data, const CXIdxEntityRefInfo* ref) {
 
       referenced = referenced.template_specialization_to_template_definition();
 
-      IndexId::Var var_id = db->ToVarId(referenced.get_usr_hash());
+      IndexId::Var var_id = db->ToVarId(referenced.cx_cursor);
       IndexVar* var = db->Resolve(var_id);
       // Lambda paramaters are not processed by OnIndexDeclaration and
       // may not have a short_name yet. Note that we only process the lambda
@@ -2085,8 +2113,8 @@ void OnIndexReference(CXClientData client_data, const CXIdxEntityRefInfo* ref) {
       // TODO: search full history?
       Range loc = cursor.get_spell();
 
-      IndexId::Func called_id =
-          db->ToFuncId(HashUsr(ref->referencedEntity->USR));
+      IndexId::Func called_id = db->ToFuncId(ref->referencedEntity->cursor,
+                                             ref->referencedEntity->USR);
       IndexFunc* called = db->Resolve(called_id);
 
       std::string_view short_name = called->def.ShortName();
@@ -2179,7 +2207,7 @@ void OnIndexReference(CXClientData client_data, const CXIdxEntityRefInfo* ref) {
     case CXIdxEntity_CXXClass: {
       referenced = referenced.template_specialization_to_template_definition();
       IndexType* ref_type =
-          db->Resolve(db->ToTypeId(referenced.get_usr_hash()));
+          db->Resolve(db->ToTypeId(referenced.cx_cursor));
       if (!ref->parentEntity || IsDeclContext(ref->parentEntity->kind))
         AddRefSpell(db, ref_type->declarations, ref->cursor);
       else
@@ -2192,7 +2220,7 @@ void OnIndexReference(CXClientData client_data, const CXIdxEntityRefInfo* ref) {
 optional<std::vector<std::unique_ptr<IndexFile>>> Parse(
     FileConsumerSharedState* file_consumer_shared,
     const std::string& file0,
-    const std::vector<std::string>& args,
+    const InternedArgs& args,
     const std::vector<FileContents>& file_contents,
     ClangIndex* index,
     bool dump_ast) {
@@ -2272,10 +2300,14 @@ optional<std::vector<std::unique_ptr<IndexFile>>> Parse(
       inc_to_line[inc.resolved_path] = inc.line;
 
   auto result = param.file_consumer->TakeLocalState();
-  auto args_hash = HashArguments(args);
+  auto args_hash = args.hash();
   for (std::unique_ptr<IndexFile>& entry : result) {
     entry->import_file = *file;
     entry->args_hash = args_hash;
+    // The cursors are only valid while the TU is alive.
+    entry->cursor_to_type_id.clear();
+    entry->cursor_to_func_id.clear();
+    entry->cursor_to_var_id.clear();
     for (IndexFunc& func : entry->funcs) {
       // e.g. declaration + out-of-line definition
       Uniquify(func.derived);
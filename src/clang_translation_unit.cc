@@ -65,7 +65,7 @@ void EmitDiagnostics(std::string path,
 std::unique_ptr<ClangTranslationUnit> ClangTranslationUnit::Create(
     ClangIndex* index,
     const AbsolutePath& filepath,
-    const std::vector<std::string>& arguments,
+    const InternedArgs& arguments,
     std::vector<CXUnsavedFile>& unsaved_files,
     unsigned flags) {
   std::vector<const char*> args;
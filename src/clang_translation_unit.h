@@ -3,6 +3,7 @@
 #include "clang_cursor.h"
 #include "clang_index.h"
 #include "file_types.h"
+#include "interned_args.h"
 
 #include <clang-c/Index.h>
 
@@ -17,7 +18,7 @@ struct ClangTranslationUnit {
   static std::unique_ptr<ClangTranslationUnit> Create(
       ClangIndex* index,
       const AbsolutePath& filepath,
-      const std::vector<std::string>& arguments,
+      const InternedArgs& arguments,
       std::vector<CXUnsavedFile>& unsaved_files,
       unsigned flags);
 
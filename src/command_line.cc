@@ -4,6 +4,7 @@
 #include "code_complete_cache.h"
 #include "diagnostics_engine.h"
 #include "file_consumer.h"
+#include "file_watcher.h"
 #include "import_manager.h"
 #include "import_pipeline.h"
 #include "include_complete.h"
@@ -12,6 +13,7 @@
 #include "lru_cache.h"
 #include "lsp_diagnostic.h"
 #include "match.h"
+#include "memory_stats.h"
 #include "message_handler.h"
 #include "options.h"
 #include "platform.h"
@@ -35,6 +37,7 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <chrono>
 #include <functional>
 #include <iostream>
 #include <iterator>
@@ -137,6 +140,22 @@ void WriteQueryDbStatus(bool is_active) {
   QueueManager::WriteStdout(kMethodType_CqueryQueryDbStatus, out);
 }
 
+void LogMemoryStats(QueryDatabase* db,
+                    WorkingFiles* working_files,
+                    ClangCompleteManager* clang_complete) {
+  if (g_config->memoryStatsLogFrequencyMs <= 0)
+    return;
+
+  static auto last_logged = std::chrono::steady_clock::now();
+  auto now = std::chrono::steady_clock::now();
+  if (now - last_logged <
+      std::chrono::milliseconds(g_config->memoryStatsLogFrequencyMs))
+    return;
+  last_logged = now;
+  LOG_S(INFO) << "Memory: "
+              << GetMemoryStats(db, working_files, clang_complete).ToString();
+}
+
 }  // namespace
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -169,7 +188,8 @@ bool QueryDbMainLoop(QueryDatabase* db,
                      IncludeComplete* include_complete,
                      CodeCompleteCache* global_code_complete_cache,
                      CodeCompleteCache* non_global_code_complete_cache,
-                     CodeCompleteCache* signature_cache) {
+                     CodeCompleteCache* signature_cache,
+                     FileWatcher* file_watcher) {
   auto* queue = QueueManager::instance();
   bool did_work = false;
 
@@ -196,7 +216,7 @@ bool QueryDbMainLoop(QueryDatabase* db,
   }
 
   if (QueryDb_ImportMain(db, import_manager, status, semantic_cache,
-                         working_files)) {
+                         working_files, file_watcher)) {
     did_work = true;
   }
 
@@ -235,6 +255,13 @@ void RunQueryDbThread(const std::string& bin_name) {
   ImportPipelineStatus import_pipeline_status;
   TimestampManager timestamp_manager;
   QueryDatabase db;
+  // Changes are handled like a workspace/didChangeWatchedFiles notification
+  // from the client.
+  FileWatcher file_watcher([](std::vector<AbsolutePath> changed,
+                              std::vector<AbsolutePath> deleted) {
+    QueueManager::instance()->for_querydb.Enqueue(
+        MakeDidChangeWatchedFiles(changed, deleted), false /*priority*/);
+  });
 
   // Setup shared references.
   for (MessageHandler* handler : *MessageHandler::message_handlers) {
@@ -264,11 +291,12 @@ void RunQueryDbThread(const std::string& bin_name) {
         &import_pipeline_status, &timestamp_manager, &semantic_cache,
         &working_files, &clang_complete, &include_complete,
         global_code_complete_cache.get(), non_global_code_complete_cache.get(),
-        signature_cache.get());
+        signature_cache.get(), &file_watcher);
 
     if (!did_work) {
       // Cleanup and free any unused memory.
       FreeUnusedMemory();
+      LogMemoryStats(&db, &working_files, &clang_complete);
 
       WriteQueryDbStatus(false);
       auto* queue = QueueManager::instance();
@@ -92,12 +92,35 @@ struct Config {
   // If true, inactive regions notifications will be sent to the client.
   bool emitInactiveRegions = false;
 
+  // How often the querydb thread logs the memory used by its largest data
+  // structures, as reported in detail by $cquery/memoryStats. 0 disables the
+  // log line.
+  int memoryStatsLogFrequencyMs = 10 * 60 * 1000;
+
   // If true, document links are reported for #include directives.
   bool showDocumentLinksOnIncludes = true;
 
+  struct CodeAction {
+    // Extensions of header files, which "implement function" code actions pair
+    // with the source file of the same name in the same directory.
+    std::vector<std::string> headerExtensions = {".h", ".hh", ".hpp", ".hxx"};
+    // Extensions of source files, in order of preference.
+    std::vector<std::string> sourceExtensions = {".cc", ".cpp", ".cxx", ".c",
+                                                 ".mm", ".m"};
+  };
+  CodeAction codeAction;
+
   struct CodeLens {
     // Enables code lens on parameter and function variables.
     bool localVariables = true;
+
+    // If true, code lenses only carry reference counts, and the locations are
+    // computed when cquery.showReferences is run through
+    // workspace/executeCommand. Like the locations, the counts are limited to
+    // xref.maxNum. Leave this off for clients which run the
+    // command themselves using the locations in its arguments, such as
+    // vscode-cquery.
+    bool lazyLocations = false;
   };
   CodeLens codeLens;
 
@@ -193,6 +216,13 @@ struct Config {
     // blacklisted files.
     std::vector<std::string> blacklist;
     std::vector<std::string> whitelist;
+
+    // If true, the highlighting published after a file is reindexed only
+    // contains the symbols whose ranges changed since the previous
+    // publication, with |incremental| set; removed symbols are sent with no
+    // ranges. Opening or viewing a file always publishes everything. The
+    // client must support this.
+    bool incremental = false;
   };
   Highlight highlight;
 
@@ -229,6 +259,23 @@ struct Config {
 
     // Number of indexer threads. If 0, 80% of cores are used.
     int threads = 0;
+
+    // Backpressure for the initial index, where parsing outruns querydb.
+    // Indexer threads stop parsing non-interactive translation units while
+    // this many parsed files or index updates are queued for querydb, and
+    // build or merge updates instead. 0 disables the limit.
+    int maxPendingUpdates = 500;
+
+    // Same, but parsing also stops while the process uses more than this many
+    // MB and updates are queued. 0 disables the limit.
+    int maxMemoryMb = 0;
+
+    // If true, cquery watches the directories of indexed files itself and
+    // reindexes changed files, including the translation units which include
+    // a changed header. Useful when the client does not send
+    // workspace/didChangeWatchedFiles or files are edited outside of it.
+    // Only supported on Linux.
+    bool watchFiles = false;
   };
   Index index;
 
@@ -252,7 +299,8 @@ struct Config {
   };
   Xref xref;
 };
-MAKE_REFLECT_STRUCT(Config::CodeLens, localVariables);
+MAKE_REFLECT_STRUCT(Config::CodeAction, headerExtensions, sourceExtensions);
+MAKE_REFLECT_STRUCT(Config::CodeLens, localVariables, lazyLocations);
 MAKE_REFLECT_STRUCT(Config::Completion,
                     enableSnippets,
                     detailedLabel,
@@ -269,7 +317,11 @@ MAKE_REFLECT_STRUCT(Config::Diagnostics,
                     frequencyMs,
                     onParse,
                     onType)
-MAKE_REFLECT_STRUCT(Config::Highlight, enabled, blacklist, whitelist)
+MAKE_REFLECT_STRUCT(Config::Highlight,
+                    enabled,
+                    blacklist,
+                    whitelist,
+                    incremental)
 MAKE_REFLECT_STRUCT(Config::Index,
                     attributeMakeCallsToCtor,
                     blacklist,
@@ -277,7 +329,10 @@ MAKE_REFLECT_STRUCT(Config::Index,
                     comments,
                     enabled,
                     logSkippedPaths,
-                    threads);
+                    threads,
+                    maxPendingUpdates,
+                    maxMemoryMb,
+                    watchFiles);
 MAKE_REFLECT_STRUCT(Config::WorkspaceSymbol, maxNum, sort);
 MAKE_REFLECT_STRUCT(Config::Xref, maxNum);
 MAKE_REFLECT_STRUCT(Config,
@@ -293,9 +348,11 @@ MAKE_REFLECT_STRUCT(Config,
                     progressReportFrequencyMs,
                     emitQueryDbBlocked,
                     emitInactiveRegions,
+                    memoryStatsLogFrequencyMs,
 
                     showDocumentLinksOnIncludes,
 
+                    codeAction,
                     codeLens,
                     completion,
                     formatting,
@@ -0,0 +1,178 @@
+#include "file_watcher.h"
+
+#include "utils.h"
+#include "work_thread.h"
+
+#include <loguru.hpp>
+
+#if defined(__linux__)
+#include <errno.h>
+#include <poll.h>
+#include <string.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+#include <algorithm>
+#include <chrono>
+#include <mutex>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace {
+
+// Editors and build tools usually touch several files at once, so wait until
+// events stop arriving before reporting them.
+const int kDebounceMs = 300;
+// ... but report continuous changes at least this often.
+const int kMaxDelayMs = 2000;
+
+}  // namespace
+
+struct FileWatcher::State {
+  OnChange on_change;
+
+  // Guards the members below, which Watch() updates from other threads.
+  std::mutex mutex;
+  int fd = -1;
+  bool failed = false;
+  // Watched directories, ending in a slash.
+  std::unordered_set<std::string> directories;
+  std::unordered_map<int, std::string> wd_to_directory;
+};
+
+FileWatcher::FileWatcher(OnChange on_change)
+    : state_(std::make_shared<State>()) {
+  state_->on_change = std::move(on_change);
+}
+
+FileWatcher::~FileWatcher() = default;
+
+#if defined(__linux__)
+
+void FileWatcher::Watch(const std::string& directory0) {
+  std::string directory = directory0;
+  EnsureEndsInSlash(directory);
+
+  std::lock_guard<std::mutex> lock(state_->mutex);
+  if (state_->failed || !state_->directories.insert(directory).second)
+    return;
+
+  if (state_->fd < 0) {
+    state_->fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (state_->fd < 0) {
+      LOG_S(WARNING) << "Unable to initialize inotify: " << strerror(errno);
+      state_->failed = true;
+      return;
+    }
+    std::shared_ptr<State> state = state_;
+    WorkThread::StartThread("file_watcher",
+                            [state]() { Run(state); });
+  }
+
+  // IN_CLOSE_WRITE instead of IN_MODIFY avoids reporting partial writes, and
+  // IN_MOVED_TO covers editors which save by renaming a temporary file.
+  int wd = inotify_add_watch(state_->fd, directory.c_str(),
+                             IN_CLOSE_WRITE | IN_CREATE | IN_MOVED_TO |
+                                 IN_DELETE | IN_MOVED_FROM | IN_ONLYDIR);
+  if (wd < 0) {
+    // Usually ENOSPC, ie, fs.inotify.max_user_watches was reached.
+    LOG_S(WARNING) << "Unable to watch " << directory << ": "
+                   << strerror(errno);
+    return;
+  }
+  state_->wd_to_directory[wd] = directory;
+}
+
+// static
+void FileWatcher::Run(std::shared_ptr<State> state) {
+  using Clock = std::chrono::steady_clock;
+
+  int fd;
+  {
+    std::lock_guard<std::mutex> lock(state->mutex);
+    fd = state->fd;
+  }
+
+  // The last event for a path decides whether it was changed or deleted.
+  std::unordered_set<std::string> changed;
+  std::unordered_set<std::string> deleted;
+  Clock::time_point first_event;
+  alignas(inotify_event) char buffer[64 * 1024];
+
+  while (true) {
+    int timeout = -1;
+    if (!changed.empty() || !deleted.empty()) {
+      int waited = (int)std::chrono::duration_cast<std::chrono::milliseconds>(
+                       Clock::now() - first_event)
+                       .count();
+      timeout = std::max(0, std::min(kDebounceMs, kMaxDelayMs - waited));
+    }
+
+    pollfd pfd = {fd, POLLIN, 0};
+    int ready = poll(&pfd, 1, timeout);
+    if (ready < 0) {
+      if (errno == EINTR)
+        continue;
+      LOG_S(ERROR) << "File watcher stopped: " << strerror(errno);
+      return;
+    }
+
+    if (ready == 0) {
+      std::vector<AbsolutePath> changed_paths;
+      std::vector<AbsolutePath> deleted_paths;
+      for (const std::string& path : changed)
+        changed_paths.push_back(AbsolutePath(path, false /*validate*/));
+      for (const std::string& path : deleted)
+        deleted_paths.push_back(AbsolutePath(path, false /*validate*/));
+      changed.clear();
+      deleted.clear();
+      state->on_change(std::move(changed_paths), std::move(deleted_paths));
+      continue;
+    }
+
+    ssize_t length = read(fd, buffer, sizeof(buffer));
+    if (length <= 0)
+      continue;
+    if (changed.empty() && deleted.empty())
+      first_event = Clock::now();
+
+    std::lock_guard<std::mutex> lock(state->mutex);
+    for (char* it = buffer; it < buffer + length;) {
+      auto* event = reinterpret_cast<inotify_event*>(it);
+      it += sizeof(inotify_event) + event->len;
+
+      if (event->mask & IN_Q_OVERFLOW) {
+        LOG_S(WARNING) << "inotify queue overflowed; run "
+                          "$cquery/freshenIndex to pick up missed changes";
+        continue;
+      }
+      auto directory = state->wd_to_directory.find(event->wd);
+      if (directory == state->wd_to_directory.end())
+        continue;
+      if (event->mask & IN_IGNORED) {
+        // The directory was deleted or unmounted. Allow watching it again.
+        state->directories.erase(directory->second);
+        state->wd_to_directory.erase(directory);
+        continue;
+      }
+      if (event->len == 0 || (event->mask & IN_ISDIR))
+        continue;
+
+      std::string path = directory->second + event->name;
+      if (event->mask & (IN_DELETE | IN_MOVED_FROM)) {
+        changed.erase(path);
+        deleted.insert(path);
+      } else {
+        deleted.erase(path);
+        changed.insert(path);
+      }
+    }
+  }
+}
+
+#else
+
+void FileWatcher::Watch(const std::string& directory) {}
+
+#endif
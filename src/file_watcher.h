@@ -0,0 +1,34 @@
+#pragma once
+
+#include "file_types.h"
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+// In-process file watcher, so that the index stays fresh when the client does
+// not send workspace/didChangeWatchedFiles or files are edited outside of the
+// editor.
+//
+// Events are debounced and reported in batches on the watcher thread. Only
+// implemented on Linux (inotify); elsewhere Watch() does nothing.
+class FileWatcher {
+ public:
+  using OnChange = std::function<void(std::vector<AbsolutePath> changed,
+                                      std::vector<AbsolutePath> deleted)>;
+
+  explicit FileWatcher(OnChange on_change);
+  ~FileWatcher();
+
+  // Reports changes to the files directly inside |directory|. Watching the
+  // same directory again is cheap. Starts the watcher thread on first use.
+  void Watch(const std::string& directory);
+
+ private:
+  struct State;
+  static void Run(std::shared_ptr<State> state);
+
+  // Shared with the watcher thread, which is never joined.
+  std::shared_ptr<State> state_;
+};
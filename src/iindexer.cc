@@ -9,7 +9,7 @@ struct ClangIndexer : IIndexer {
   optional<std::vector<std::unique_ptr<IndexFile>>> Index(
       FileConsumerSharedState* file_consumer_shared,
       std::string file,
-      const std::vector<std::string>& args,
+      const InternedArgs& args,
       const std::vector<FileContents>& file_contents) override {
     return Parse(file_consumer_shared, file, args, file_contents, &index,
                  false /*dump_ast*/);
@@ -47,7 +47,7 @@ struct TestIndexer : IIndexer {
   optional<std::vector<std::unique_ptr<IndexFile>>> Index(
       FileConsumerSharedState* file_consumer_shared,
       std::string file,
-      const std::vector<std::string>& args,
+      const InternedArgs& args,
       const std::vector<FileContents>& file_contents) override {
     auto it = indexes.find(file);
     if (it == indexes.end()) {
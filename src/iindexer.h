@@ -1,5 +1,7 @@
 #pragma once
 
+#include "interned_args.h"
+
 #include <optional.h>
 
 #include <initializer_list>
@@ -36,6 +38,6 @@ struct IIndexer {
   virtual optional<std::vector<std::unique_ptr<IndexFile>>> Index(
       FileConsumerSharedState* file_consumer_shared,
       std::string file,
-      const std::vector<std::string>& args,
+      const InternedArgs& args,
       const std::vector<FileContents>& file_contents) = 0;
 };
@@ -4,6 +4,7 @@
 #include "code_complete_cache.h"
 #include "config.h"
 #include "diagnostics_engine.h"
+#include "file_watcher.h"
 #include "iindexer.h"
 #include "import_manager.h"
 #include "lsp.h"
@@ -140,7 +141,7 @@ ChangeResult ComputeChangeStatus(
     const std::shared_ptr<ICacheManager>& cache_manager,
     IndexFile* opt_previous_index,
     const AbsolutePath& path,
-    const std::vector<std::string>& args,
+    const InternedArgs& args,
     const optional<AbsolutePath>& from) {
   auto unwrap_opt = [](const optional<AbsolutePath>& opt) -> std::string {
     if (opt)
@@ -166,7 +167,7 @@ ChangeResult ComputeChangeStatus(
   }
 
   if (opt_previous_index) {
-    if (HashArguments(args) != opt_previous_index->args_hash) {
+    if (args.hash() != opt_previous_index->args_hash) {
       LOG_S(INFO) << "Arguments have changed for " << path << unwrap_opt(from);
       return ChangeResult::kYes;
     }
@@ -401,6 +402,22 @@ void ParseFile(DiagnosticsEngine* diag_engine,
                                                  request.is_interactive);
 }
 
+// Returns true if parsed files are piling up faster than querydb imports them.
+// Indexer threads then only parse interactive requests, which bounds the
+// memory held by queued IndexFiles and IndexUpdates during the initial index.
+bool IsPipelineFull(QueueManager* queue) {
+  size_t pending = queue->do_id_map.Size() + queue->on_id_mapped.Size() +
+                   queue->on_indexed_for_merge.Size() +
+                   queue->on_indexed_for_querydb.Size();
+  if (pending == 0)
+    return false;
+  if (g_config->index.maxPendingUpdates > 0 &&
+      pending >= (size_t)g_config->index.maxPendingUpdates)
+    return true;
+  return g_config->index.maxMemoryMb > 0 &&
+         GetProcessMemoryUsedInMb() >= g_config->index.maxMemoryMb;
+}
+
 bool IndexMain_DoParse(
     DiagnosticsEngine* diag_engine,
     WorkingFiles* working_files,
@@ -411,7 +428,8 @@ bool IndexMain_DoParse(
     IIndexer* indexer) {
   auto* queue = QueueManager::instance();
   optional<Index_Request> request =
-      queue->index_request.TryDequeue(true /*priority*/);
+      IsPipelineFull(queue) ? queue->index_request.TryDequeuePriority()
+                            : queue->index_request.TryDequeue(true /*priority*/);
   if (!request)
     return false;
 
@@ -550,9 +568,18 @@ void Indexer_Main(DiagnosticsEngine* diag_engine,
 
     // We didn't do any work, so wait for a notification.
     if (!did_work) {
-      QueueManager::instance()->indexer_waiter->Wait(
-          &queue->index_request, &queue->on_id_mapped,
-          &queue->load_previous_index, &queue->on_indexed_for_merge);
+      if (IsPipelineFull(queue)) {
+        // Pending index requests cannot be parsed yet. querydb notifies the
+        // waiter when it imports updates; the timeout covers lost wakeups.
+        queue->indexer_waiter->WaitFor(std::chrono::milliseconds(100),
+                                       &queue->on_id_mapped,
+                                       &queue->load_previous_index,
+                                       &queue->on_indexed_for_merge);
+      } else {
+        queue->indexer_waiter->Wait(
+            &queue->index_request, &queue->on_id_mapped,
+            &queue->load_previous_index, &queue->on_indexed_for_merge);
+      }
     }
   }
 }
@@ -587,6 +614,7 @@ void QueryDb_OnIndexed(QueueManager* queue,
                        ImportPipelineStatus* status,
                        SemanticHighlightSymbolCache* semantic_cache,
                        WorkingFiles* working_files,
+                       FileWatcher* file_watcher,
                        Index_OnIndexed* response) {
   Timer time;
   db->ApplyIndexUpdate(&response->update);
@@ -608,10 +636,18 @@ void QueryDb_OnIndexed(QueueManager* queue,
       // Semantic highlighting.
       QueryId::File file_id = db->usr_to_file[working_file->filename];
       QueryFile* file = &db->files[file_id.id];
-      EmitSemanticHighlighting(db, semantic_cache, working_file, file);
+      EmitSemanticHighlighting(db, semantic_cache, working_file, file,
+                               false /*full*/);
     }
   }
 
+  // Headers are indexed as part of their translation units, so this also
+  // watches the directories of dependencies.
+  if (file_watcher && g_config->index.watchFiles) {
+    for (auto& updated_file : response->update.files_def_update)
+      file_watcher->Watch(GetDirName(updated_file.value.path));
+  }
+
   // Set pipeline status to imported so the file can be updated in the future.
   std::vector<std::string> paths;
   paths.reserve(response->update.files_def_update.size());
@@ -631,7 +667,8 @@ bool QueryDb_ImportMain(QueryDatabase* db,
                         ImportManager* import_manager,
                         ImportPipelineStatus* status,
                         SemanticHighlightSymbolCache* semantic_cache,
-                        WorkingFiles* working_files) {
+                        WorkingFiles* working_files,
+                        FileWatcher* file_watcher) {
   auto* queue = QueueManager::instance();
 
   ActiveThread active_thread(status);
@@ -657,9 +694,14 @@ bool QueryDb_ImportMain(QueryDatabase* db,
       break;
     did_work = true;
     QueryDb_OnIndexed(queue, db, import_manager, status, semantic_cache,
-                      working_files, &*response);
+                      working_files, file_watcher, &*response);
   }
 
+  // Indexer threads may be holding back index requests until querydb catches
+  // up.
+  if (did_work)
+    queue->indexer_waiter->cv.notify_all();
+
   return did_work;
 }
 
@@ -687,7 +729,7 @@ TEST_SUITE("ImportPipeline") {
                      const std::string& contents = "void foo();") {
       queue->index_request.Enqueue(
           Index_Request(path, args, is_interactive, contents, cache_manager),
-          false /*priority*/);
+          is_interactive /*priority*/);
     }
 
     QueueManager* queue = nullptr;
@@ -799,4 +841,35 @@ TEST_SUITE("ImportPipeline") {
 
     REQUIRE(file_consumer_shared.used_files.empty());
   }
+
+  TEST_CASE_FIXTURE(Fixture, "backpressure") {
+    indexer = IIndexer::MakeTestIndexer({IIndexer::TestEntry{"foo.cc", 100},
+                                         IIndexer::TestEntry{"bar.cc", 5},
+                                         IIndexer::TestEntry{"baz.cc", 1}});
+    int max_pending_updates = g_config->index.maxPendingUpdates;
+    g_config->index.maxPendingUpdates = 100;
+
+    MakeRequest("foo.cc");
+    MakeRequest("bar.cc");
+    REQUIRE(PumpOnce());
+    REQUIRE(queue->do_id_map.Size() == 100);
+
+    // querydb has not caught up, so bar.cc is held back...
+    REQUIRE(!PumpOnce());
+    REQUIRE(queue->index_request.Size() == 1);
+
+    // ... but interactive requests are not.
+    MakeRequest("baz.cc", {}, true /*is_interactive*/);
+    REQUIRE(PumpOnce());
+    REQUIRE(queue->do_id_map.Size() == 101);
+    REQUIRE(queue->index_request.Size() == 1);
+
+    while (queue->do_id_map.TryDequeue(true /*priority*/)) {
+    }
+    REQUIRE(PumpOnce());
+    REQUIRE(queue->index_request.Size() == 0);
+    REQUIRE(queue->do_id_map.Size() == 5);
+
+    g_config->index.maxPendingUpdates = max_pending_updates;
+  }
 }
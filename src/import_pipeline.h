@@ -4,6 +4,7 @@
 
 struct DiagnosticsEngine;
 struct FileConsumerSharedState;
+class FileWatcher;
 struct ImportManager;
 struct Project;
 struct QueryDatabase;
@@ -30,8 +31,10 @@ void Indexer_Main(DiagnosticsEngine* diag_engine,
                   CodeCompleteCache* global_code_complete_cache,
                   CodeCompleteCache* non_global_code_complete_cache);
 
+// |file_watcher| may be null.
 bool QueryDb_ImportMain(QueryDatabase* db,
                         ImportManager* import_manager,
                         ImportPipelineStatus* status,
                         SemanticHighlightSymbolCache* semantic_cache,
-                        WorkingFiles* working_files);
+                        WorkingFiles* working_files,
+                        FileWatcher* file_watcher);
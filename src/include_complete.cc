@@ -7,15 +7,14 @@
 #include "timer.h"
 #include "work_thread.h"
 
+#include <doctest/doctest.h>
+
+#include <algorithm>
 #include <thread>
+#include <tuple>
 
 namespace {
 
-struct CompletionCandidate {
-  std::string absolute_path;
-  lsCompletionItem completion_item;
-};
-
 std::string ElideLongPath(const std::string& path) {
   if (g_config->completion.includeMaxPathSize <= 0)
     return path;
@@ -98,17 +97,196 @@ lsCompletionItem BuildCompletionItem(const std::string& path,
 
 }  // namespace
 
+// Label-indexed include paths. Only accessed under IncludeComplete::mutex_,
+// except while a new index is being built by Rescan.
+struct IncludeComplete::Index {
+  struct Node {
+    // Sorted by character.
+    std::vector<std::pair<char, int>> children;
+    // Items whose label ends at this node.
+    std::vector<int> items;
+    // CharMask of every character below this node. Never shrinks, which only
+    // makes pruning less effective.
+    uint64_t mask = 0;
+  };
+
+  // Removed items stay in |items| with a zero |refs| count until the next
+  // rescan.
+  std::vector<lsCompletionItem> items;
+  // Number of absolute paths which produced each item.
+  std::vector<int> refs;
+  std::vector<Node> nodes = std::vector<Node>(1);
+
+  // Absolute file path to the item in |items|. Keep the one with shortest
+  // include path.
+  std::unordered_map<std::string, int> absolute_path_to_item;
+  // All items produced by an absolute path, one per include directory it is
+  // reachable from.
+  std::unordered_map<std::string, std::vector<int>> absolute_path_to_items;
+  // Only one completion item per include path.
+  std::unordered_map<std::string, int> inserted_paths;
+
+  static uint64_t CharMask(char c) {
+    return 1ull << (tolower(static_cast<unsigned char>(c)) & 63);
+  }
+
+  int FindOrAddChild(int node, char c) {
+    auto& children = nodes[node].children;
+    auto it = std::lower_bound(children.begin(), children.end(),
+                               std::make_pair(c, 0));
+    if (it != children.end() && it->first == c)
+      return it->second;
+    int child = (int)nodes.size();
+    children.insert(it, {c, child});
+    nodes.emplace_back();
+    return child;
+  }
+
+  void AddToTrie(const std::string& label, int item) {
+    // remaining_masks[i] is the CharMask of label[i:].
+    std::vector<uint64_t> remaining_masks(label.size() + 1);
+    for (size_t i = label.size(); i--;)
+      remaining_masks[i] = remaining_masks[i + 1] | CharMask(label[i]);
+    int node = 0;
+    for (size_t i = 0; i < label.size(); ++i) {
+      nodes[node].mask |= remaining_masks[i];
+      node = FindOrAddChild(node, label[i]);
+    }
+    nodes[node].items.push_back(item);
+  }
+
+  void RemoveFromTrie(const std::string& label, int item) {
+    int node = 0;
+    for (char c : label) {
+      auto& children = nodes[node].children;
+      auto it = std::lower_bound(children.begin(), children.end(),
+                                 std::make_pair(c, 0));
+      if (it == children.end() || it->first != c)
+        return;
+      node = it->second;
+    }
+    auto& node_items = nodes[node].items;
+    node_items.erase(std::remove(node_items.begin(), node_items.end(), item),
+                     node_items.end());
+  }
+
+  // Standard library headers have an empty |absolute_path| and do not take
+  // part in de-duplication.
+  void Insert(const std::string& absolute_path, lsCompletionItem&& item) {
+    int index;
+    auto it = absolute_path.empty() ? inserted_paths.end()
+                                    : inserted_paths.find(item.detail);
+    if (it == inserted_paths.end()) {
+      index = (int)items.size();
+      if (!absolute_path.empty())
+        inserted_paths[item.detail] = index;
+      AddToTrie(item.label, index);
+      items.push_back(std::move(item));
+      refs.push_back(absolute_path.empty() ? 1 : 0);
+    } else {
+      index = it->second;
+      // Update |use_angle_brackets_|, prefer quotes.
+      if (!item.use_angle_brackets_)
+        items[index].use_angle_brackets_ = false;
+    }
+    if (absolute_path.empty())
+      return;
+
+    std::vector<int>& produced = absolute_path_to_items[absolute_path];
+    if (std::find(produced.begin(), produced.end(), index) == produced.end()) {
+      produced.push_back(index);
+      ++refs[index];
+    }
+    // insert if not found or with shorter include path
+    auto best = absolute_path_to_item.find(absolute_path);
+    if (best == absolute_path_to_item.end() ||
+        items[best->second].detail.length() > items[index].detail.length())
+      absolute_path_to_item[absolute_path] = index;
+  }
+
+  void Remove(const std::string& absolute_path) {
+    auto it = absolute_path_to_items.find(absolute_path);
+    if (it == absolute_path_to_items.end())
+      return;
+    for (int index : it->second) {
+      if (--refs[index] > 0)
+        continue;
+      inserted_paths.erase(items[index].detail);
+      RemoveFromTrie(items[index].label, index);
+    }
+    absolute_path_to_items.erase(it);
+    absolute_path_to_item.erase(absolute_path);
+  }
+
+  std::vector<lsCompletionItem> Find(const std::string& pattern) const {
+    std::vector<lsCompletionItem> result;
+    if (pattern.empty()) {
+      for (size_t i = 0; i < items.size(); ++i)
+        if (refs[i] > 0)
+          result.push_back(items[i]);
+      return result;
+    }
+
+    bool case_sensitive =
+        std::any_of(pattern.begin(), pattern.end(), isupper);
+    // remaining_masks[i] is the CharMask of pattern[i:].
+    std::vector<uint64_t> remaining_masks(pattern.size() + 1);
+    for (size_t i = pattern.size(); i--;)
+      remaining_masks[i] = remaining_masks[i + 1] | CharMask(pattern[i]);
+
+    // Greedily match |pattern| as a subsequence along each trie path, which
+    // finds a match whenever one exists. Once the whole pattern is matched,
+    // every item below the node matches.
+    std::vector<int> matched_items;
+    std::vector<int> subtrees;
+    std::vector<std::pair<int, size_t>> stack = {{0, 0}};
+    while (!stack.empty()) {
+      int node;
+      size_t matched;
+      std::tie(node, matched) = stack.back();
+      stack.pop_back();
+      if (matched == pattern.size()) {
+        subtrees.push_back(node);
+        continue;
+      }
+      if (remaining_masks[matched] & ~nodes[node].mask)
+        continue;
+      char expected = pattern[matched];
+      for (const auto& child : nodes[node].children) {
+        bool match = case_sensitive ? child.first == expected
+                                    : tolower(child.first) == tolower(expected);
+        stack.emplace_back(child.second, matched + (match ? 1 : 0));
+      }
+    }
+    while (!subtrees.empty()) {
+      int node = subtrees.back();
+      subtrees.pop_back();
+      matched_items.insert(matched_items.end(), nodes[node].items.begin(),
+                           nodes[node].items.end());
+      for (const auto& child : nodes[node].children)
+        subtrees.push_back(child.second);
+    }
+
+    // Keep the insertion order, like a scan over |items| would.
+    std::sort(matched_items.begin(), matched_items.end());
+    result.reserve(matched_items.size());
+    for (int index : matched_items)
+      result.push_back(items[index]);
+    return result;
+  }
+};
+
 IncludeComplete::IncludeComplete(Project* project)
-    : is_scanning(false), project_(project) {}
+    : is_scanning(false),
+      index_(std::make_unique<Index>()),
+      project_(project) {}
+
+IncludeComplete::~IncludeComplete() = default;
 
 void IncludeComplete::Rescan() {
   if (is_scanning)
     return;
 
-  completion_items.clear();
-  absolute_path_to_completion_item.clear();
-  inserted_paths.clear();
-
   if (!match_ && (!g_config->completion.includeWhitelist.empty() ||
                   !g_config->completion.includeBlacklist.empty()))
     match_ =
@@ -119,37 +297,48 @@ void IncludeComplete::Rescan() {
   WorkThread::StartThread("scan_includes", [this]() {
     Timer timer;
 
-    InsertStlIncludes();
-    InsertIncludesFromDirectory(g_config->projectRoot,
+    // Build the new index without holding |mutex_| so that completion keeps
+    // being served from the old one.
+    auto index = std::make_unique<Index>();
+    for (const char* stl_header : kStandardLibraryIncludes) {
+      index->Insert("", BuildCompletionItem(stl_header,
+                                            true /*use_angle_brackets*/,
+                                            true /*is_stl*/));
+    }
+    InsertIncludesFromDirectory(index.get(), g_config->projectRoot,
                                 false /*use_angle_brackets*/);
     for (const Directory& dir : project_->quote_include_directories)
-      InsertIncludesFromDirectory(dir.path, false /*use_angle_brackets*/);
+      InsertIncludesFromDirectory(index.get(), dir.path,
+                                  false /*use_angle_brackets*/);
     for (const Directory& dir : project_->angle_include_directories)
-      InsertIncludesFromDirectory(dir.path, true /*use_angle_brackets*/);
+      InsertIncludesFromDirectory(index.get(), dir.path,
+                                  true /*use_angle_brackets*/);
+
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      for (const auto& pending : pending_files_) {
+        if (pending.second)
+          index->Insert(pending.first, BuildFileCompletionItem(pending.first));
+        else
+          index->Remove(pending.first);
+      }
+      pending_files_.clear();
+      // The old index is destroyed after the lock is released.
+      index_.swap(index);
+      is_scanning = false;
+    }
 
     timer.ResetAndPrint("[perf] Scanning for includes");
-    is_scanning = false;
   });
 }
 
-void IncludeComplete::InsertCompletionItem(const std::string& absolute_path,
-                                           lsCompletionItem&& item) {
-  if (inserted_paths.insert({item.detail, inserted_paths.size()}).second) {
-    completion_items.push_back(item);
-    // insert if not found or with shorter include path
-    auto it = absolute_path_to_completion_item.find(absolute_path);
-    if (it == absolute_path_to_completion_item.end() ||
-        completion_items[it->second].detail.length() > item.detail.length()) {
-      absolute_path_to_completion_item[absolute_path] =
-          completion_items.size() - 1;
-    }
-  } else {
-    lsCompletionItem& inserted_item =
-        completion_items[inserted_paths[item.detail]];
-    // Update |use_angle_brackets_|, prefer quotes.
-    if (!item.use_angle_brackets_)
-      inserted_item.use_angle_brackets_ = false;
-  }
+lsCompletionItem IncludeComplete::BuildFileCompletionItem(
+    const std::string& absolute_path) {
+  std::string trimmed_path = absolute_path;
+  bool use_angle_brackets =
+      TrimPath(project_, g_config->projectRoot, &trimmed_path);
+  return BuildCompletionItem(trimmed_path, use_angle_brackets,
+                             false /*is_stl*/);
 }
 
 void IncludeComplete::AddFile(const std::string& absolute_path) {
@@ -158,21 +347,22 @@ void IncludeComplete::AddFile(const std::string& absolute_path) {
   if (match_ && !match_->IsMatch(absolute_path))
     return;
 
-  std::string trimmed_path = absolute_path;
-  bool use_angle_brackets =
-      TrimPath(project_, g_config->projectRoot, &trimmed_path);
-  lsCompletionItem item =
-      BuildCompletionItem(trimmed_path, use_angle_brackets, false /*is_stl*/);
+  lsCompletionItem item = BuildFileCompletionItem(absolute_path);
+  std::lock_guard<std::mutex> lock(mutex_);
+  index_->Insert(absolute_path, std::move(item));
+  if (is_scanning)
+    pending_files_.emplace_back(absolute_path, true);
+}
 
-  std::unique_lock<std::mutex> lock(completion_items_mutex, std::defer_lock);
+void IncludeComplete::RemoveFile(const std::string& absolute_path) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  index_->Remove(absolute_path);
   if (is_scanning)
-    lock.lock();
-  InsertCompletionItem(absolute_path, std::move(item));
-  if (lock)
-    lock.unlock();
+    pending_files_.emplace_back(absolute_path, false);
 }
 
-void IncludeComplete::InsertIncludesFromDirectory(std::string directory0,
+void IncludeComplete::InsertIncludesFromDirectory(Index* index,
+                                                  std::string directory0,
                                                   bool use_angle_brackets) {
   optional<AbsolutePath> directory = NormalizePath(directory0);
   if (!directory)
@@ -184,42 +374,78 @@ void IncludeComplete::InsertIncludesFromDirectory(std::string directory0,
     return;
   }
 
-  std::vector<CompletionCandidate> results;
-  GetFilesAndDirectoriesInFolder(
-      directory->path, true /*recursive*/, false /*add_folder_to_path*/,
-      [&](const std::string& path) {
-        if (!EndsWithAny(path, g_config->completion.includeSuffixWhitelist))
-          return;
-        if (match_ && !match_->IsMatch(directory->path + path))
-          return;
-
-        CompletionCandidate candidate;
-        candidate.absolute_path = directory->path + path;
-        candidate.completion_item =
-            BuildCompletionItem(path, use_angle_brackets, false /*is_stl*/);
-        results.push_back(candidate);
+  // Subdirectories are pruned only when a blacklist pattern matches them, since
+  // whitelist patterns usually describe files.
+  std::vector<std::string> paths = GetFilesInFolderParallel(
+      directory->path, false /*add_folder_to_path*/,
+      [this](const std::string& dir) {
+        if (!match_)
+          return true;
+        for (const Matcher& matcher : match_->blacklist) {
+          if (matcher.IsMatch(dir))
+            return false;
+        }
+        return true;
+      },
+      [this](const std::string& path) {
+        return EndsWithAny(path, g_config->completion.includeSuffixWhitelist) &&
+               (!match_ || match_->IsMatch(path));
       });
 
-  std::lock_guard<std::mutex> lock(completion_items_mutex);
-  for (CompletionCandidate& result : results)
-    InsertCompletionItem(result.absolute_path,
-                         std::move(result.completion_item));
-}
-
-void IncludeComplete::InsertStlIncludes() {
-  std::lock_guard<std::mutex> lock(completion_items_mutex);
-  for (const char* stl_header : kStandardLibraryIncludes) {
-    completion_items.push_back(BuildCompletionItem(
-        stl_header, true /*use_angle_brackets*/, true /*is_stl*/));
+  for (const std::string& path : paths) {
+    index->Insert(directory->path + path,
+                  BuildCompletionItem(path, use_angle_brackets,
+                                      false /*is_stl*/));
   }
 }
 
 optional<lsCompletionItem> IncludeComplete::FindCompletionItemForAbsolutePath(
     const std::string& absolute_path) {
-  std::lock_guard<std::mutex> lock(completion_items_mutex);
+  std::lock_guard<std::mutex> lock(mutex_);
 
-  auto it = absolute_path_to_completion_item.find(absolute_path);
-  if (it == absolute_path_to_completion_item.end())
+  auto it = index_->absolute_path_to_item.find(absolute_path);
+  if (it == index_->absolute_path_to_item.end())
     return nullopt;
-  return completion_items[it->second];
+  return index_->items[it->second];
+}
+
+std::vector<lsCompletionItem> IncludeComplete::FindMatchingItems(
+    const std::string& pattern) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return index_->Find(pattern);
+}
+
+TEST_SUITE("IncludeComplete") {
+  TEST_CASE("incremental updates and subsequence lookup") {
+    Project project;
+    IncludeComplete include_complete(&project);
+    auto labels = [&](const std::string& pattern) {
+      std::vector<std::string> result;
+      for (const lsCompletionItem& item :
+           include_complete.FindMatchingItems(pattern))
+        result.push_back(item.label);
+      return result;
+    };
+
+    include_complete.AddFile("/a/vector.h");
+    include_complete.AddFile("/a/string.h");
+    include_complete.AddFile("/b/VecMath.h");
+    include_complete.AddFile("/a/readme.txt");
+    REQUIRE(labels("") == std::vector<std::string>{"/a/vector.h", "/a/string.h",
+                                                   "/b/VecMath.h"});
+    REQUIRE(labels("vec") ==
+            std::vector<std::string>{"/a/vector.h", "/b/VecMath.h"});
+    REQUIRE(labels("Vec") == std::vector<std::string>{"/b/VecMath.h"});
+    REQUIRE(labels("asth") == std::vector<std::string>{"/a/string.h"});
+    REQUIRE(labels("xyz").empty());
+    REQUIRE(include_complete.FindCompletionItemForAbsolutePath("/a/vector.h"));
+
+    include_complete.RemoveFile("/a/vector.h");
+    REQUIRE(labels("vec") == std::vector<std::string>{"/b/VecMath.h"});
+    REQUIRE(!include_complete.FindCompletionItemForAbsolutePath("/a/vector.h"));
+
+    include_complete.AddFile("/a/vector.h");
+    REQUIRE(labels("vec") ==
+            std::vector<std::string>{"/b/VecMath.h", "/a/vector.h"});
+  }
 }
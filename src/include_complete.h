@@ -3,6 +3,7 @@
 #include "lsp_completion.h"
 
 #include <atomic>
+#include <memory>
 #include <mutex>
 #include <unordered_set>
 
@@ -11,38 +12,45 @@ struct Project;
 
 struct IncludeComplete {
   IncludeComplete(Project* project);
+  ~IncludeComplete();
 
-  // Starts scanning directories. Clears existing cache.
+  // Starts scanning directories in the background. Until the scan finishes,
+  // queries are answered from the previous index, which keeps receiving
+  // AddFile/RemoveFile updates.
   void Rescan();
 
-  // Ensures the one-off file is inside |completion_items|.
+  // Ensures the one-off file is in the index.
   void AddFile(const std::string& absolute_path);
-
-  // Scans the given directory and inserts all includes from this. This is a
-  // blocking function and should be run off the querydb thread.
-  void InsertIncludesFromDirectory(std::string directory,
-                                   bool use_angle_brackets);
-  void InsertStlIncludes();
+  // Removes the completion items which only exist because of this file.
+  void RemoveFile(const std::string& absolute_path);
 
   optional<lsCompletionItem> FindCompletionItemForAbsolutePath(
       const std::string& absolute_path);
 
-  // Insert item to |completion_items|.
-  // Update |absolute_path_to_completion_item| and |inserted_paths|.
-  void InsertCompletionItem(const std::string& absolute_path,
-                            lsCompletionItem&& item);
+  // Returns copies of the items whose label contains |pattern| as a
+  // subsequence, compared like CaseFoldingSubsequenceMatch does. Items which
+  // cannot match are pruned with a trie over the labels, so they are never
+  // copied. An empty |pattern| returns every item.
+  std::vector<lsCompletionItem> FindMatchingItems(const std::string& pattern);
 
-  // Guards |completion_items| when |is_scanning| is true.
-  std::mutex completion_items_mutex;
   std::atomic<bool> is_scanning;
-  std::vector<lsCompletionItem> completion_items;
 
-  // Absolute file path to the completion item in |completion_items|.
-  // Keep the one with shortest include path.
-  std::unordered_map<std::string, int> absolute_path_to_completion_item;
+ private:
+  struct Index;
 
-  // Only one completion item per include path.
-  std::unordered_map<std::string, int> inserted_paths;
+  // Scans the given directory and inserts all includes from this. This is a
+  // blocking function and should be run off the querydb thread.
+  void InsertIncludesFromDirectory(Index* index,
+                                   std::string directory,
+                                   bool use_angle_brackets);
+  lsCompletionItem BuildFileCompletionItem(const std::string& absolute_path);
+
+  // Guards |index_| and |pending_files_|.
+  std::mutex mutex_;
+  std::unique_ptr<Index> index_;
+  // AddFile (true) and RemoveFile (false) calls received while scanning, which
+  // are replayed on the new index before it replaces |index_|.
+  std::vector<std::pair<std::string, bool>> pending_files_;
 
   // Cached references
   Project* project_;
@@ -484,15 +484,23 @@ struct IndexFile {
   std::vector<lsDiagnostic> diagnostics_;
   // File contents at the time of index. Not serialized.
   std::string file_contents;
+  // Ids resolved from cursors while indexing, keyed by canonical cursor, so
+  // that references to an already seen entity skip USR generation and
+  // |id_cache|. Not serialized; cleared once the TU has been indexed.
+  std::unordered_map<ClangCursor, IndexId::Type> cursor_to_type_id;
+  std::unordered_map<ClangCursor, IndexId::Func> cursor_to_func_id;
+  std::unordered_map<ClangCursor, IndexId::Var> cursor_to_var_id;
 
   IndexFile(const AbsolutePath& path);
 
   IndexId::Type ToTypeId(Usr usr);
   IndexId::Func ToFuncId(Usr usr);
   IndexId::Var ToVarId(Usr usr);
-  IndexId::Type ToTypeId(const CXCursor& usr);
-  IndexId::Func ToFuncId(const CXCursor& usr);
-  IndexId::Var ToVarId(const CXCursor& usr);
+  // |usr|, if known (eg, CXIdxEntityInfo::USR), saves generating it when
+  // |cursor| has not been seen yet.
+  IndexId::Type ToTypeId(const CXCursor& cursor, const char* usr = nullptr);
+  IndexId::Func ToFuncId(const CXCursor& cursor, const char* usr = nullptr);
+  IndexId::Var ToVarId(const CXCursor& cursor, const char* usr = nullptr);
   IndexType* Resolve(IndexId::Type id);
   IndexFunc* Resolve(IndexId::Func id);
   IndexVar* Resolve(IndexId::Var id);
@@ -515,7 +523,7 @@ struct NamespaceHelper {
 optional<std::vector<std::unique_ptr<IndexFile>>> Parse(
     FileConsumerSharedState* file_consumer_shared,
     const std::string& file,
-    const std::vector<std::string>& args,
+    const InternedArgs& args,
     const std::vector<FileContents>& file_contents,
     ClangIndex* index,
     bool dump_ast = false);
@@ -0,0 +1,141 @@
+#include "interned_args.h"
+
+#include "serializer.h"
+#include "utils.h"
+
+#include <doctest/doctest.h>
+
+#include <algorithm>
+#include <mutex>
+#include <unordered_map>
+
+namespace {
+
+// Maps each interned string to the number of references from Data, so that
+// per-entry strings such as source and output paths are freed once no list
+// uses them anymore.
+struct StringPool {
+  std::mutex mutex;
+  std::unordered_map<std::string, size_t> strings;
+};
+
+StringPool* GetStringPool() {
+  static StringPool* pool = new StringPool();
+  return pool;
+}
+
+size_t GetPooledStringCount() {
+  StringPool* pool = GetStringPool();
+  std::lock_guard<std::mutex> lock(pool->mutex);
+  return pool->strings.size();
+}
+
+}  // namespace
+
+InternedArgs::Data::~Data() {
+  StringPool* pool = GetStringPool();
+  std::lock_guard<std::mutex> lock(pool->mutex);
+  for (const std::string* arg : args) {
+    auto it = pool->strings.find(*arg);
+    if (--it->second == 0)
+      pool->strings.erase(it);
+  }
+}
+
+InternedArgs::InternedArgs(const std::vector<std::string>& args) {
+  if (args.empty())
+    return;
+
+  auto data = std::make_shared<Data>();
+  data->args.reserve(args.size());
+  data->hash = HashArguments(args);
+  StringPool* pool = GetStringPool();
+  {
+    std::lock_guard<std::mutex> lock(pool->mutex);
+    for (const std::string& arg : args) {
+      auto it = pool->strings.find(arg);
+      if (it == pool->strings.end())
+        it = pool->strings.emplace(arg, 0).first;
+      ++it->second;
+      data->args.push_back(&it->first);
+    }
+  }
+  data_ = std::move(data);
+}
+
+InternedArgs::InternedArgs(std::initializer_list<std::string> args)
+    : InternedArgs(std::vector<std::string>(args)) {}
+
+InternedArgs::const_iterator InternedArgs::begin() const {
+  return const_iterator(data_ ? data_->args.data() : nullptr);
+}
+
+InternedArgs::const_iterator InternedArgs::end() const {
+  return const_iterator(data_ ? data_->args.data() + data_->args.size()
+                              : nullptr);
+}
+
+std::vector<std::string> InternedArgs::ToVector() const {
+  return std::vector<std::string>(begin(), end());
+}
+
+bool InternedArgs::operator==(const InternedArgs& o) const {
+  if (data_ == o.data_)
+    return true;
+  // Equal strings are interned to the same pointer.
+  return size() == o.size() && hash() == o.hash() &&
+         data_->args == o.data_->args;
+}
+
+bool InternedArgs::operator==(const std::vector<std::string>& o) const {
+  return size() == o.size() && std::equal(begin(), end(), o.begin());
+}
+
+void Reflect(Reader& visitor, InternedArgs& value) {
+  std::vector<std::string> args;
+  Reflect(visitor, args);
+  value = args;
+}
+
+void Reflect(Writer& visitor, InternedArgs& value) {
+  visitor.StartArray(value.size());
+  for (const std::string& arg : value)
+    visitor.String(arg.c_str(), arg.size());
+  visitor.EndArray();
+}
+
+TEST_SUITE("InternedArgs") {
+  TEST_CASE("shares strings") {
+    InternedArgs a = {"clang++", "-DA", "a.cc"};
+    InternedArgs b = std::vector<std::string>{"clang++", "-DA", "b.cc"};
+    REQUIRE(&a[0] == &b[0]);
+    REQUIRE(&a[1] == &b[1]);
+    REQUIRE(&a[2] != &b[2]);
+    REQUIRE(a != b);
+    REQUIRE(a == std::vector<std::string>{"clang++", "-DA", "a.cc"});
+    REQUIRE(a == InternedArgs({"clang++", "-DA", "a.cc"}));
+    REQUIRE(a.ToVector() == std::vector<std::string>{"clang++", "-DA", "a.cc"});
+  }
+
+  TEST_CASE("frees unused strings") {
+    size_t count = GetPooledStringCount();
+    {
+      InternedArgs a = {"-o", "/interned_args_test/a.o"};
+      InternedArgs b = a;
+      InternedArgs c = {"-MF", "/interned_args_test/a.o"};
+      REQUIRE(GetPooledStringCount() >= count + 1);
+      REQUIRE(&a[1] == &c[1]);
+      a = InternedArgs();
+      REQUIRE(&b[1] == &c[1]);
+    }
+    REQUIRE(GetPooledStringCount() == count);
+  }
+
+  TEST_CASE("hash") {
+    std::vector<std::string> args = {"clang++", "-DA", "a.cc"};
+    REQUIRE(InternedArgs(args).hash() == HashArguments(args));
+    REQUIRE(InternedArgs().hash() == HashArguments({}));
+    REQUIRE(InternedArgs().empty());
+    REQUIRE(InternedArgs() == std::vector<std::string>{});
+  }
+}
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <cstddef>
+#include <initializer_list>
+#include <iterator>
+#include <memory>
+#include <string>
+#include <vector>
+
+class Reader;
+class Writer;
+
+// Immutable, reference counted list of compiler arguments.
+//
+// Every distinct argument is stored once for the whole process, so the entries
+// of a project, which usually share almost all of their flags, only pay for a
+// pointer per flag. A stored argument is freed with the last list using it.
+// Copying an InternedArgs only bumps a reference count, which lets
+// Project::Entry, Index_Request and completion sessions share one list.
+class InternedArgs {
+ public:
+  class const_iterator {
+   public:
+    using iterator_category = std::forward_iterator_tag;
+    using value_type = std::string;
+    using difference_type = std::ptrdiff_t;
+    using pointer = const std::string*;
+    using reference = const std::string&;
+
+    explicit const_iterator(const std::string* const* it) : it_(it) {}
+
+    reference operator*() const { return **it_; }
+    pointer operator->() const { return *it_; }
+    const_iterator& operator++() {
+      ++it_;
+      return *this;
+    }
+    const_iterator operator++(int) { return const_iterator(it_++); }
+    bool operator==(const const_iterator& o) const { return it_ == o.it_; }
+    bool operator!=(const const_iterator& o) const { return it_ != o.it_; }
+
+   private:
+    const std::string* const* it_;
+  };
+
+  InternedArgs() = default;
+  // Not explicit so that call sites which build a std::vector<std::string> can
+  // pass or assign it directly.
+  InternedArgs(const std::vector<std::string>& args);
+  InternedArgs(std::initializer_list<std::string> args);
+
+  size_t size() const { return data_ ? data_->args.size() : 0; }
+  bool empty() const { return size() == 0; }
+  const_iterator begin() const;
+  const_iterator end() const;
+  const std::string& operator[](size_t i) const { return *data_->args[i]; }
+  const std::string& front() const { return *data_->args.front(); }
+  const std::string& back() const { return *data_->args.back(); }
+
+  // HashArguments() of the list, computed once on construction.
+  size_t hash() const { return data_ ? data_->hash : 0; }
+
+  // Returns a copy of the arguments which can be modified.
+  std::vector<std::string> ToVector() const;
+
+  bool operator==(const InternedArgs& o) const;
+  bool operator!=(const InternedArgs& o) const { return !(*this == o); }
+  bool operator==(const std::vector<std::string>& o) const;
+  bool operator!=(const std::vector<std::string>& o) const {
+    return !(*this == o);
+  }
+
+ private:
+  struct Data {
+    // Releases |args| from the string pool.
+    ~Data();
+
+    std::vector<const std::string*> args;
+    size_t hash = 0;
+  };
+  std::shared_ptr<const Data> data_;
+};
+
+void Reflect(Reader& visitor, InternedArgs& value);
+void Reflect(Writer& visitor, InternedArgs& value);
@@ -1,5 +1,6 @@
 #pragma once
 
+#include "indexer.h"
 #include "lsp.h"
 
 // codeAction
@@ -13,18 +14,41 @@ MAKE_REFLECT_STRUCT_WRITER_AS_ARRAY(CommandArgs, textDocumentUri, edits);
 struct lsCodeLensUserData {};
 MAKE_REFLECT_EMPTY_STRUCT(lsCodeLensUserData);
 
+// Identifies the references behind a code lens, so that they can be computed
+// when the lens is executed instead of when it is displayed. See
+// Config::CodeLens::lazyLocations.
+struct lsCodeLensRefs {
+  enum class Type : uint8_t {
+    Uses,
+    Derived,
+    Instances,
+    Bases,
+    BaseCalls,
+    DerivedCalls
+  };
+
+  SymbolIdx symbol;
+  Type type;
+};
+MAKE_REFLECT_TYPE_PROXY(lsCodeLensRefs::Type);
+MAKE_REFLECT_STRUCT(lsCodeLensRefs, symbol, type);
+
 struct lsCodeLensCommandArguments {
   lsDocumentUri uri;
   lsPosition position;
   std::vector<lsLocation> locations;
+  // Set instead of |locations| if they are computed lazily.
+  optional<lsCodeLensRefs> refs;
 };
 
 // FIXME Don't use array in vscode-cquery
 inline void Reflect(Writer& visitor, lsCodeLensCommandArguments& value) {
-  visitor.StartArray(3);
+  visitor.StartArray(value.refs ? 4 : 3);
   Reflect(visitor, value.uri);
   Reflect(visitor, value.position);
   Reflect(visitor, value.locations);
+  if (value.refs)
+    Reflect(visitor, *value.refs);
   visitor.EndArray();
 }
 
@@ -41,6 +65,10 @@ inline void Reflect(Reader& visitor, lsCodeLensCommandArguments& value) {
       case 2:
         Reflect(visitor, value.locations);
         break;
+      case 3:
+        value.refs = lsCodeLensRefs();
+        Reflect(visitor, *value.refs);
+        break;
     }
   });
 }
@@ -2,20 +2,38 @@
 
 #include <optional.h>
 
+#include <mutex>
 #include <regex>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
 struct Matcher {
+  // How the pattern is evaluated. Most patterns in the wild are plain
+  // substrings such as ".*third_party.*", which do not need a regex engine.
+  enum class Kind { Regex, Contains, Prefix, Suffix, Equals };
+
   static optional<Matcher> Create(const std::string& search);
 
   bool IsMatch(const std::string& value) const;
+  // Same as IsMatch, but |lowered_value| must be |value| converted to
+  // lowercase and contain |literal| if it is not empty.
+  bool IsMatch(const std::string& value,
+               const std::string& lowered_value) const;
 
   std::string regex_string;
   std::regex regex;
+  Kind kind = Kind::Regex;
+  // Lowercase string which every matching value contains. For kinds other
+  // than Regex this is the whole pattern. May be empty.
+  std::string literal;
 };
 
 // Check multiple |Matcher| instances at the same time.
+//
+// The literals of all patterns are compiled into one Aho-Corasick automaton,
+// so a value is scanned once and only patterns whose literal occurs in it are
+// evaluated. Results are cached per value.
 struct GroupMatch {
   GroupMatch(const std::vector<std::string>& whitelist,
              const std::vector<std::string>& blacklist);
@@ -25,4 +43,26 @@ struct GroupMatch {
 
   std::vector<Matcher> whitelist;
   std::vector<Matcher> blacklist;
-};
\ No newline at end of file
+
+ private:
+  struct Node {
+    // Indexed by byte. 0 means no transition, since the root is never a
+    // transition target after construction.
+    int next[256] = {};
+    int fail = 0;
+    // Matchers (index into whitelist, then blacklist) whose literal ends here,
+    // including those reachable through |fail|.
+    std::vector<int> outputs;
+  };
+
+  // Returns the index of the first matcher (whitelist, then blacklist) which
+  // matches |value|, or -1.
+  int FindFirstMatch(const std::string& value) const;
+
+  std::vector<Node> nodes_;
+  // Matchers without a literal, which have to be evaluated for every value.
+  std::vector<int> unfiltered_;
+
+  mutable std::mutex cache_mutex_;
+  mutable std::unordered_map<std::string, int> cache_;
+};
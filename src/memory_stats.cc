@@ -0,0 +1,265 @@
+#include "memory_stats.h"
+
+#include "cache_manager.h"
+#include "clang_complete.h"
+#include "query.h"
+#include "queue_manager.h"
+#include "utils.h"
+#include "working_files.h"
+
+#include <doctest/doctest.h>
+
+#include <algorithm>
+#include <iomanip>
+#include <sstream>
+
+namespace {
+
+// Number of entries in the log line, largest first.
+const size_t kMaxLoggedEntries = 10;
+
+template <typename T>
+size_t Bytes(const std::vector<T>& values) {
+  return values.capacity() * sizeof(T);
+}
+size_t Bytes(const std::string& value) {
+  return value.capacity();
+}
+
+template <typename Map>
+size_t TableBytes(const Map& map) {
+  return map.size() * sizeof(typename Map::value_type);
+}
+
+template <typename Def>
+size_t DefStringBytes(const Def& def) {
+  return Bytes(def.detailed_name) + Bytes(def.hover) + Bytes(def.comments);
+}
+
+size_t DefVectorBytes(const QueryType::Def& def) {
+  return Bytes(def.bases) + Bytes(def.types) + Bytes(def.funcs) +
+         Bytes(def.vars);
+}
+size_t DefVectorBytes(const QueryFunc::Def& def) {
+  return Bytes(def.bases) + Bytes(def.vars) + Bytes(def.callees);
+}
+size_t DefVectorBytes(const QueryVar::Def& def) {
+  return 0;
+}
+
+// Adds |name| with the elements of |member| in all |entities|.
+template <typename Q, typename T>
+void AddMember(MemoryStats* stats,
+               const std::string& name,
+               const std::vector<Q>& entities,
+               std::vector<T> Q::*member) {
+  size_t count = 0, bytes = 0;
+  for (const Q& entity : entities) {
+    count += (entity.*member).size();
+    bytes += Bytes(entity.*member);
+  }
+  stats->Add(name, count, bytes);
+}
+
+template <typename Q>
+void AddEntities(MemoryStats* stats,
+                 const std::string& name,
+                 const std::vector<Q>& entities) {
+  size_t defs = 0, def_bytes = 0, string_bytes = 0;
+  for (const Q& entity : entities) {
+    defs += entity.def.size();
+    def_bytes += Bytes(entity.def);
+    for (const typename Q::Def& def : entity.def) {
+      def_bytes += DefVectorBytes(def);
+      string_bytes += DefStringBytes(def);
+    }
+  }
+  stats->Add(name, entities.size(), Bytes(entities));
+  stats->Add(name + ".def", defs, def_bytes);
+  stats->Add(name + ".def.strings", defs, string_bytes);
+  AddMember(stats, name + ".declarations", entities, &Q::declarations);
+  AddMember(stats, name + ".uses", entities, &Q::uses);
+}
+
+void AddFiles(MemoryStats* stats, const QueryDatabase& db) {
+  size_t bytes = Bytes(db.files);
+  for (const QueryFile& file : db.files) {
+    if (!file.def)
+      continue;
+    const QueryFile::Def& def = *file.def;
+    bytes += Bytes(def.path.path) + Bytes(def.language) + Bytes(def.includes) +
+             Bytes(def.outline) + Bytes(def.all_symbols) +
+             Bytes(def.all_symbols_max_end) + Bytes(def.inactive_regions) +
+             Bytes(def.dependencies);
+    for (const IndexInclude& include : def.includes)
+      bytes += Bytes(include.resolved_path);
+    for (const AbsolutePath& dependency : def.dependencies)
+      bytes += Bytes(dependency.path);
+  }
+  stats->Add("files", db.files.size(), bytes);
+}
+
+void AddLookupTables(MemoryStats* stats, const QueryDatabase& db) {
+  stats->Add("symbols", db.symbols.size(), Bytes(db.symbols));
+
+  size_t bytes = TableBytes(db.usr_to_file);
+  for (const auto& entry : db.usr_to_file)
+    bytes += Bytes(entry.first.path);
+  stats->Add("usr_to_file", db.usr_to_file.size(), bytes);
+  stats->Add("usr_to_type", db.usr_to_type.size(), TableBytes(db.usr_to_type));
+  stats->Add("usr_to_func", db.usr_to_func.size(), TableBytes(db.usr_to_func));
+  stats->Add("usr_to_var", db.usr_to_var.size(), TableBytes(db.usr_to_var));
+
+  bytes = Bytes(db.file_dependents);
+  for (const std::vector<RawId>& dependents : db.file_dependents)
+    bytes += Bytes(dependents);
+  stats->Add("file_dependents", db.file_dependents.size(), bytes);
+
+  bytes = TableBytes(db.path_stem_to_files);
+  for (const auto& entry : db.path_stem_to_files)
+    bytes += Bytes(entry.first) + Bytes(entry.second);
+  stats->Add("path_stem_to_files", db.path_stem_to_files.size(), bytes);
+
+  bytes = TableBytes(db.resolved_path_to_includes);
+  for (const auto& entry : db.resolved_path_to_includes)
+    bytes += Bytes(entry.first) + Bytes(entry.second);
+  stats->Add("resolved_path_to_includes", db.resolved_path_to_includes.size(),
+             bytes);
+
+  bytes = TableBytes(db.short_name_to_symbols);
+  for (const auto& entry : db.short_name_to_symbols)
+    bytes += Bytes(entry.first) + Bytes(entry.second);
+  stats->Add("short_name_to_symbols", db.short_name_to_symbols.size(), bytes);
+}
+
+void AddWorkingFiles(MemoryStats* stats, WorkingFiles* working_files) {
+  size_t count = 0, bytes = 0;
+  working_files->DoAction([&]() {
+    count = working_files->files.size();
+    for (const std::unique_ptr<WorkingFile>& file : working_files->files) {
+      bytes += sizeof(WorkingFile) + Bytes(file->buffer_content) +
+               Bytes(file->index_lines) + Bytes(file->buffer_lines) +
+               Bytes(file->index_to_buffer) + Bytes(file->buffer_to_index);
+      for (const std::string& line : file->index_lines)
+        bytes += Bytes(line);
+      for (const std::string& line : file->buffer_lines)
+        bytes += Bytes(line);
+    }
+  });
+  stats->Add("working_files", count, bytes);
+}
+
+// Queued items are only counted; their size is not known without walking
+// into every message.
+void AddQueues(MemoryStats* stats) {
+  QueueManager* queue = QueueManager::instance();
+  stats->Add("queue.for_stdout", queue->for_stdout.Size(), 0);
+  stats->Add("queue.for_querydb", queue->for_querydb.Size(), 0);
+  stats->Add("queue.do_id_map", queue->do_id_map.Size(), 0);
+  stats->Add("queue.index_request", queue->index_request.Size(), 0);
+  stats->Add("queue.load_previous_index", queue->load_previous_index.Size(),
+             0);
+  stats->Add("queue.on_id_mapped", queue->on_id_mapped.Size(), 0);
+  stats->Add("queue.on_indexed_for_merge", queue->on_indexed_for_merge.Size(),
+             0);
+  stats->Add("queue.on_indexed_for_querydb",
+             queue->on_indexed_for_querydb.Size(), 0);
+}
+
+}  // namespace
+
+void MemoryStats::Add(const std::string& name, size_t count, size_t bytes) {
+  Entry entry;
+  entry.name = name;
+  entry.count = count;
+  entry.bytes = bytes;
+  entries.push_back(entry);
+  totalBytes += bytes;
+}
+
+std::string MemoryStats::ToString() const {
+  auto to_mb = [](size_t bytes) { return bytes / 1024.0 / 1024.0; };
+
+  std::vector<const Entry*> largest;
+  for (const Entry& entry : entries)
+    largest.push_back(&entry);
+  std::stable_sort(largest.begin(), largest.end(),
+                   [](const Entry* a, const Entry* b) {
+                     return a->bytes > b->bytes;
+                   });
+  if (largest.size() > kMaxLoggedEntries)
+    largest.resize(kMaxLoggedEntries);
+
+  std::ostringstream out;
+  out << std::fixed << std::setprecision(1) << "process " << processMb
+      << "mb, tracked " << to_mb(totalBytes) << "mb";
+  for (const Entry* entry : largest) {
+    out << "; " << entry->name << " " << to_mb(entry->bytes) << "mb ("
+        << entry->count << ")";
+  }
+  return out.str();
+}
+
+MemoryStats GetMemoryStats(QueryDatabase* db,
+                           WorkingFiles* working_files,
+                           ClangCompleteManager* clang_complete) {
+  MemoryStats stats;
+  stats.processMb = GetProcessMemoryUsedInMb();
+
+  AddFiles(&stats, *db);
+  AddEntities(&stats, "types", db->types);
+  AddMember(&stats, "types.derived", db->types, &QueryType::derived);
+  AddMember(&stats, "types.instances", db->types, &QueryType::instances);
+  AddEntities(&stats, "funcs", db->funcs);
+  AddMember(&stats, "funcs.derived", db->funcs, &QueryFunc::derived);
+  AddEntities(&stats, "vars", db->vars);
+  AddLookupTables(&stats, *db);
+
+  AddWorkingFiles(&stats, working_files);
+
+  size_t sessions, session_bytes;
+  clang_complete->GetMemoryUsage(&sessions, &session_bytes);
+  stats.Add("completion_sessions", sessions, session_bytes);
+
+  AddQueues(&stats);
+  // Loaded IndexFiles are only counted, since they are owned by the indexer
+  // threads.
+  stats.Add("cache_manager.loaded", ICacheManager::LoadedCacheCount(), 0);
+
+  return stats;
+}
+
+TEST_SUITE("MemoryStats") {
+  TEST_CASE("entities") {
+    QueryDatabase db;
+    db.funcs.push_back(QueryFunc(1));
+    db.funcs.push_back(QueryFunc(2));
+    db.funcs[0].def.resize(1);
+    db.funcs[0].def[0].detailed_name = "void foo()";
+    db.funcs[0].uses.resize(3);
+    db.funcs[1].uses.resize(1);
+    db.funcs[1].declarations.resize(2);
+
+    MemoryStats stats;
+    AddEntities(&stats, "funcs", db.funcs);
+    auto find = [&](const std::string& name) {
+      for (const MemoryStats::Entry& entry : stats.entries)
+        if (entry.name == name)
+          return entry;
+      return MemoryStats::Entry();
+    };
+
+    REQUIRE(find("funcs").count == 2);
+    REQUIRE(find("funcs.def").count == 1);
+    REQUIRE(find("funcs.def.strings").bytes >= 10);
+    REQUIRE(find("funcs.uses").count == 4);
+    REQUIRE(find("funcs.uses").bytes >= 4 * sizeof(QueryId::LexicalRef));
+    REQUIRE(find("funcs.declarations").count == 2);
+
+    size_t total = 0;
+    for (const MemoryStats::Entry& entry : stats.entries)
+      total += entry.bytes;
+    REQUIRE(stats.totalBytes == total);
+    REQUIRE(stats.ToString().find("funcs.uses") != std::string::npos);
+  }
+}
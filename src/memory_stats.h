@@ -0,0 +1,40 @@
+#pragma once
+
+#include "serializer.h"
+
+#include <string>
+#include <vector>
+
+struct ClangCompleteManager;
+struct QueryDatabase;
+struct WorkingFiles;
+
+// Approximate memory used by the long lived data structures. Sizes are
+// derived from container capacities and string lengths, without allocator
+// overhead, so collecting them is linear in the number of entities and cheap
+// enough to do periodically.
+struct MemoryStats {
+  struct Entry {
+    std::string name;
+    size_t count = 0;
+    size_t bytes = 0;
+  };
+
+  // As reported by the OS.
+  double processMb = 0;
+  // Sum of |entries|.
+  size_t totalBytes = 0;
+  std::vector<Entry> entries;
+
+  void Add(const std::string& name, size_t count, size_t bytes);
+
+  // Single line summary for the log.
+  std::string ToString() const;
+};
+MAKE_REFLECT_STRUCT(MemoryStats::Entry, name, count, bytes);
+MAKE_REFLECT_STRUCT(MemoryStats, processMb, totalBytes, entries);
+
+// Must be called on the querydb thread.
+MemoryStats GetMemoryStats(QueryDatabase* db,
+                           WorkingFiles* working_files,
+                           ClangCompleteManager* clang_complete);
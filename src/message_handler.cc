@@ -1,6 +1,7 @@
 #include "message_handler.h"
 
 #include "lex_utils.h"
+#include "lsp_code_action.h"
 #include "project.h"
 #include "query_utils.h"
 #include "queue_manager.h"
@@ -127,7 +128,8 @@ MAKE_HASHABLE(SymbolAndRole, t.symbol, t.role);
 void EmitSemanticHighlighting(QueryDatabase* db,
                               SemanticHighlightSymbolCache* semantic_cache,
                               WorkingFile* working_file,
-                              QueryFile* file) {
+                              QueryFile* file,
+                              bool full) {
   if (!g_config->highlight.enabled)
     return;
 
@@ -141,7 +143,7 @@ void EmitSemanticHighlighting(QueryDatabase* db,
   std::unordered_map<SymbolAndRole, Out_CqueryPublishSemanticHighlighting::Symbol>
       grouped_symbols;
   for (QueryId::SymbolRef sym : file->def->all_symbols) {
-    std::string_view detailed_name;
+    Usr usr;
     lsSymbolKind parent_kind = lsSymbolKind::Unknown;
     lsSymbolKind kind = lsSymbolKind::Unknown;
     StorageClass storage = StorageClass::Invalid;
@@ -153,6 +155,7 @@ void EmitSemanticHighlighting(QueryDatabase* db,
         const QueryFunc::Def* def = func.AnyDef();
         if (!def)
           continue;  // applies to for loop
+        usr = func.usr;
         if (def->spell)
           parent_kind = GetSymbolKind(db, *def->spell);
         if (parent_kind == lsSymbolKind::Unknown) {
@@ -171,14 +174,13 @@ void EmitSemanticHighlighting(QueryDatabase* db,
           parent_kind = GetSymbolKind(db, *def->spell);
         kind = def->kind;
         storage = def->storage;
-        detailed_name = short_name;
 
         // Check whether the function name is actually there.
         // If not, do not publish the semantic highlight.
         // E.g. copy-initialization of constructors should not be highlighted
         // but we still want to keep the range for jumping to definition.
         std::string_view concise_name =
-            detailed_name.substr(0, detailed_name.find('<'));
+            short_name.substr(0, short_name.find('<'));
         int16_t start_line = sym.range.start.line;
         int16_t start_col = sym.range.start.column;
         // The function is not there if this isn't at least zero.
@@ -195,22 +197,24 @@ void EmitSemanticHighlighting(QueryDatabase* db,
         }
         break;
       }
-      case SymbolKind::Type:
-        for (auto& def : db->GetType(sym).def) {
+      case SymbolKind::Type: {
+        const QueryType& type = db->GetType(sym);
+        usr = type.usr;
+        for (auto& def : type.def) {
           kind = def.kind;
-          detailed_name = def.detailed_name;
           if (def.spell) {
             parent_kind = GetSymbolKind(db, *def.spell);
             break;
           }
         }
         break;
+      }
       case SymbolKind::Var: {
         const QueryVar& var = db->GetVar(sym);
+        usr = var.usr;
         for (auto& def : var.def) {
           kind = def.kind;
           storage = def.storage;
-          detailed_name = def.detailed_name;
           if (def.spell) {
             parent_kind = GetSymbolKind(db, *def.spell);
             break;
@@ -236,8 +240,7 @@ void EmitSemanticHighlighting(QueryDatabase* db,
         it->second.ranges.push_back(*loc);
       } else {
         Out_CqueryPublishSemanticHighlighting::Symbol symbol;
-        symbol.stableId = semantic_cache_for_file->GetStableId(
-            sym.kind, std::string(detailed_name));
+        symbol.stableId = semantic_cache->GetStableId(sym.kind, usr);
         symbol.parentKind = parent_kind;
         symbol.kind = kind;
         symbol.storage = storage;
@@ -290,12 +293,121 @@ void EmitSemanticHighlighting(QueryDatabase* db,
   // Publish.
   Out_CqueryPublishSemanticHighlighting out;
   out.params.uri = lsDocumentUri::FromPath(working_file->filename);
-  for (auto& entry : grouped_symbols)
-    if (entry.second.ranges.size())
-      out.params.symbols.push_back(entry.second);
+  if (!g_config->highlight.incremental) {
+    for (auto& entry : grouped_symbols)
+      if (entry.second.ranges.size())
+        out.params.symbols.push_back(entry.second);
+    QueueManager::WriteStdout(kMethodType_CqueryPublishSemanticHighlighting,
+                              out);
+    return;
+  }
+
+  // Symbols which look the same to the client are merged, so that they can be
+  // diffed by key.
+  using Key = SemanticHighlightSymbolCache::Entry::PublishedKey;
+  std::map<Key, std::vector<lsRange>> published;
+  for (auto& entry : grouped_symbols) {
+    const Out_CqueryPublishSemanticHighlighting::Symbol& symbol = entry.second;
+    if (symbol.ranges.empty())
+      continue;
+    std::vector<lsRange>& ranges =
+        published[Key(symbol.stableId, symbol.parentKind, symbol.kind,
+                      symbol.storage, symbol.role)];
+    bool sorted = ranges.empty() || ranges.back() < symbol.ranges.front();
+    ranges.insert(ranges.end(), symbol.ranges.begin(), symbol.ranges.end());
+    if (!sorted)
+      std::sort(ranges.begin(), ranges.end());
+  }
+
+  auto add_symbol = [&](const Key& key, const std::vector<lsRange>& ranges) {
+    Out_CqueryPublishSemanticHighlighting::Symbol symbol;
+    std::tie(symbol.stableId, symbol.parentKind, symbol.kind, symbol.storage,
+             symbol.role) = key;
+    symbol.ranges = ranges;
+    out.params.symbols.push_back(std::move(symbol));
+  };
+  const auto& previous = semantic_cache_for_file->published;
+  if (full || !previous) {
+    for (auto& entry : published)
+      add_symbol(entry.first, entry.second);
+  } else {
+    // Both maps are ordered by key, so walk them in lockstep.
+    static const std::vector<lsRange> kRemoved;
+    auto it = previous->begin();
+    for (auto& entry : published) {
+      for (; it != previous->end() && it->first < entry.first; ++it)
+        add_symbol(it->first, kRemoved);
+      if (it != previous->end() && it->first == entry.first) {
+        if (it->second != entry.second)
+          add_symbol(entry.first, entry.second);
+        ++it;
+      } else {
+        add_symbol(entry.first, entry.second);
+      }
+    }
+    for (; it != previous->end(); ++it)
+      add_symbol(it->first, kRemoved);
+    out.params.incremental = true;
+  }
+  semantic_cache_for_file->published = std::move(published);
+
+  if (out.params.incremental && out.params.symbols.empty())
+    return;
   QueueManager::WriteStdout(kMethodType_CqueryPublishSemanticHighlighting, out);
 }
 
 bool ShouldIgnoreFileForIndexing(const std::string& path) {
   return StartsWith(path, "git:");
 }
+
+std::vector<QueryId::LexicalRef> GetCodeLensRefs(QueryDatabase* db,
+                                                 const lsCodeLensRefs& refs) {
+  using Type = lsCodeLensRefs::Type;
+  RawId id = refs.symbol.id.id;
+  switch (refs.symbol.kind) {
+    case SymbolKind::Type: {
+      if (id >= db->types.size())
+        break;
+      QueryType& type = db->types[id];
+      if (refs.type == Type::Uses)
+        return type.uses;
+      if (refs.type == Type::Derived)
+        return GetDeclarations(db, type.derived);
+      if (refs.type == Type::Instances)
+        return GetDeclarations(db, type.instances);
+      break;
+    }
+    case SymbolKind::Func: {
+      if (id >= db->funcs.size())
+        break;
+      QueryFunc& func = db->funcs[id];
+      if (refs.type == Type::Uses)
+        return func.uses;
+      if (refs.type == Type::Derived)
+        return GetDeclarations(db, func.derived);
+      if (refs.type == Type::Bases) {
+        if (const QueryFunc::Def* def = func.AnyDef())
+          return GetDeclarations(db, def->bases);
+      }
+      if (refs.type == Type::BaseCalls)
+        return GetRefsForAllBases(db, func);
+      if (refs.type == Type::DerivedCalls)
+        return GetRefsForAllDerived(db, func);
+      break;
+    }
+    case SymbolKind::Var: {
+      if (id < db->vars.size() && refs.type == Type::Uses)
+        return db->vars[id].uses;
+      break;
+    }
+    default:
+      break;
+  }
+  return {};
+}
+
+size_t CountCodeLensRefs(QueryDatabase* db,
+                         WorkingFiles* working_files,
+                         const lsCodeLensRefs& refs) {
+  return CountLsLocations(db, working_files, GetCodeLensRefs(db, refs));
+}
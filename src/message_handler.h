@@ -17,6 +17,7 @@ struct FileConsumerSharedState;
 struct ImportManager;
 struct ImportPipelineStatus;
 struct IncludeComplete;
+struct lsCodeLensRefs;
 struct MultiQueueWaiter;
 struct Project;
 struct QueryDatabase;
@@ -38,6 +39,9 @@ struct Out_CqueryPublishSemanticHighlighting
   struct Params {
     lsDocumentUri uri;
     std::vector<Symbol> symbols;
+    // If true, |symbols| only replaces the symbols with the same stableId,
+    // parentKind, kind, storage and role in the previous publication.
+    optional<bool> incremental;
   };
   std::string method = "$cquery/publishSemanticHighlighting";
   Params params;
@@ -51,7 +55,8 @@ MAKE_REFLECT_STRUCT(Out_CqueryPublishSemanticHighlighting::Symbol,
                     ranges);
 MAKE_REFLECT_STRUCT(Out_CqueryPublishSemanticHighlighting::Params,
                     uri,
-                    symbols);
+                    symbols,
+                    incremental);
 MAKE_REFLECT_STRUCT(Out_CqueryPublishSemanticHighlighting,
                     jsonrpc,
                     method,
@@ -115,9 +120,27 @@ bool FindFileOrFail(QueryDatabase* db,
 void EmitInactiveLines(WorkingFile* working_file,
                        const std::vector<Range>& inactive_regions);
 
+// If |full| is false and highlight.incremental is set, only the changes since
+// the previous publication for the file are sent.
 void EmitSemanticHighlighting(QueryDatabase* db,
                               SemanticHighlightSymbolCache* semantic_cache,
                               WorkingFile* working_file,
-                              QueryFile* file);
+                              QueryFile* file,
+                              bool full);
 
 bool ShouldIgnoreFileForIndexing(const std::string& path);
+
+// Returns the references behind the code lens |refs|.
+std::vector<QueryId::LexicalRef> GetCodeLensRefs(QueryDatabase* db,
+                                                 const lsCodeLensRefs& refs);
+// Same as GetLsLocations(db, working_files, GetCodeLensRefs(db, refs)).size(),
+// which is what cquery.showReferences returns for a lazy code lens.
+size_t CountCodeLensRefs(QueryDatabase* db,
+                         WorkingFiles* working_files,
+                         const lsCodeLensRefs& refs);
+
+// Builds a workspace/didChangeWatchedFiles notification, so that the
+// in-process file watcher goes through the same reindexing as the client.
+std::unique_ptr<InMessage> MakeDidChangeWatchedFiles(
+    const std::vector<AbsolutePath>& changed,
+    const std::vector<AbsolutePath>& deleted);
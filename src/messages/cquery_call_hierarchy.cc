@@ -79,28 +79,41 @@ MAKE_REFLECT_STRUCT_OPTIONALS_MANDATORY(Out_CqueryCallHierarchy,
                                         id,
                                         result);
 
-bool Expand(MessageHandler* m,
-            Out_CqueryCallHierarchy::Entry* entry,
-            bool callee,
-            CallType call_type,
-            bool detailed_name,
-            int levels) {
-  const QueryFunc& func = m->db->GetFunc(entry->id);
-  const QueryFunc::Def* def = func.AnyDef();
-  entry->numChildren = 0;
-  if (!def)
-    return false;
+// Children of call hierarchy nodes, which only depend on the index. Clients
+// expand the same nodes again and again, and heavily-called functions show up
+// many times in one tree, so they are shared between requests until the next
+// index update.
+struct CallHierarchyCache {
+  struct Child {
+    QueryId::LexicalRef ref;
+    CallType call_type;
+  };
+
+  // QueryDatabase::generation the entries were computed for.
+  uint64_t generation = 0;
+  // Keyed by MakeKey().
+  std::unordered_map<uint64_t, std::vector<Child>> children;
+
+  static uint64_t MakeKey(QueryId::Func id, bool callee, CallType call_type) {
+    return uint64_t(id.id) << 3 | uint64_t(callee) << 2 | uint64_t(call_type);
+  }
+};
+
+const std::vector<CallHierarchyCache::Child>& GetChildren(
+    QueryDatabase* db,
+    CallHierarchyCache* cache,
+    QueryId::Func id,
+    bool callee,
+    CallType call_type) {
+  uint64_t key = CallHierarchyCache::MakeKey(id, callee, call_type);
+  auto it = cache->children.find(key);
+  if (it != cache->children.end())
+    return it->second;
+  std::vector<CallHierarchyCache::Child>& children = cache->children[key];
+
+  const QueryFunc& func = db->GetFunc(id);
   auto handle = [&](QueryId::LexicalRef ref, CallType call_type) {
-    entry->numChildren++;
-    if (levels > 0) {
-      Out_CqueryCallHierarchy::Entry entry1;
-      entry1.id = QueryId::Func(ref.id);
-      if (auto loc = GetLsLocation(m->db, m->working_files, ref))
-        entry1.location = *loc;
-      entry1.callType = call_type;
-      if (Expand(m, &entry1, callee, call_type, detailed_name, levels - 1))
-        entry->children.push_back(std::move(entry1));
-    }
+    children.push_back({ref, call_type});
   };
   auto handle_uses = [&](const QueryFunc& func, CallType call_type) {
     if (callee) {
@@ -118,46 +131,51 @@ bool Expand(MessageHandler* m,
     }
   };
 
-  std::unordered_set<Usr> seen;
-  seen.insert(func.usr);
-  std::vector<const QueryFunc*> stack;
-  if (detailed_name)
-    entry->name = def->detailed_name;
-  else
-    entry->name = def->ShortName();
   handle_uses(func, CallType::Direct);
 
   // Callers/callees of base functions.
   if (call_type & CallType::Base) {
-    stack.push_back(&func);
-    while (stack.size()) {
-      const QueryFunc& func1 = *stack.back();
-      stack.pop_back();
-      if (auto* def1 = func1.AnyDef()) {
-        EachDefinedFunc(m->db, def1->bases, [&](QueryFunc& func2) {
-          if (!seen.count(func2.usr)) {
-            seen.insert(func2.usr);
-            stack.push_back(&func2);
-            handle_uses(func2, CallType::Base);
-          }
-        });
-      }
-    }
+    for (QueryId::Func func1 : db->func_hierarchy.GetClosure(db, id, false))
+      handle_uses(db->GetFunc(func1), CallType::Base);
   }
 
   // Callers/callees of derived functions.
   if (call_type & CallType::Derived) {
-    stack.push_back(&func);
-    while (stack.size()) {
-      const QueryFunc& func1 = *stack.back();
-      stack.pop_back();
-      EachDefinedFunc(m->db, func1.derived, [&](QueryFunc& func2) {
-        if (!seen.count(func2.usr)) {
-          seen.insert(func2.usr);
-          stack.push_back(&func2);
-          handle_uses(func2, CallType::Derived);
-        }
-      });
+    for (QueryId::Func func1 : db->func_hierarchy.GetClosure(db, id, true))
+      handle_uses(db->GetFunc(func1), CallType::Derived);
+  }
+  return children;
+}
+
+bool Expand(MessageHandler* m,
+            CallHierarchyCache* cache,
+            Out_CqueryCallHierarchy::Entry* entry,
+            bool callee,
+            CallType call_type,
+            bool detailed_name,
+            int levels) {
+  const QueryFunc::Def* def = m->db->GetFunc(entry->id).AnyDef();
+  entry->numChildren = 0;
+  if (!def)
+    return false;
+  if (detailed_name)
+    entry->name = def->detailed_name;
+  else
+    entry->name = def->ShortName();
+
+  const std::vector<CallHierarchyCache::Child>& children =
+      GetChildren(m->db, cache, entry->id, callee, call_type);
+  entry->numChildren = (int)children.size();
+  if (levels > 0) {
+    for (const CallHierarchyCache::Child& child : children) {
+      Out_CqueryCallHierarchy::Entry entry1;
+      entry1.id = QueryId::Func(child.ref.id);
+      if (auto loc = GetLsLocation(m->db, m->working_files, child.ref))
+        entry1.location = *loc;
+      entry1.callType = child.call_type;
+      if (Expand(m, cache, &entry1, callee, child.call_type, detailed_name,
+                 levels - 1))
+        entry->children.push_back(std::move(entry1));
     }
   }
   return true;
@@ -184,7 +202,7 @@ struct Handler_CqueryCallHierarchy
               GetLsLocation(db, working_files, *def->spell))
         entry.location = *loc;
     }
-    Expand(this, &entry, callee, call_type, detailed_name, levels);
+    Expand(this, &cache_, &entry, callee, call_type, detailed_name, levels);
     return entry;
   }
 
@@ -193,12 +211,17 @@ struct Handler_CqueryCallHierarchy
     Out_CqueryCallHierarchy out;
     out.id = request->id;
 
+    if (cache_.generation != db->generation) {
+      cache_.children.clear();
+      cache_.generation = db->generation;
+    }
+
     if (params.id) {
       Out_CqueryCallHierarchy::Entry entry;
       entry.id = *params.id;
       entry.callType = CallType::Direct;
       if (entry.id.id < db->funcs.size())
-        Expand(this, &entry, params.callee, params.callType,
+        Expand(this, &cache_, &entry, params.callee, params.callType,
                params.detailedName, params.levels);
       out.result = std::move(entry);
     } else {
@@ -221,6 +244,8 @@ struct Handler_CqueryCallHierarchy
 
     QueueManager::WriteStdout(kMethodType, out);
   }
+
+  CallHierarchyCache cache_;
 };
 REGISTER_MESSAGE_HANDLER(Handler_CqueryCallHierarchy);
 
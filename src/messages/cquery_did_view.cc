@@ -34,7 +34,8 @@ struct Handler_CqueryDidView
 
     if (file->def) {
       EmitInactiveLines(working_file, file->def->inactive_regions);
-      EmitSemanticHighlighting(db, semantic_cache, working_file, file);
+      EmitSemanticHighlighting(db, semantic_cache, working_file, file,
+                               true /*full*/);
     }
   }
 };
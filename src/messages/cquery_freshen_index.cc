@@ -45,19 +45,13 @@ struct Handler_CqueryFreshenIndex : BaseMessageHandler<In_CqueryFreshenIndex> {
     std::queue<const QueryFile*> q;
     // |need_index| stores every filename ever enqueued.
     std::unordered_set<std::string> need_index;
-    // Reverse dependency graph.
-    std::unordered_map<std::string, std::vector<std::string>> graph;
-    // filename -> QueryFile mapping for files haven't enqueued.
-    std::unordered_map<std::string, const QueryFile*> path_to_file;
+    // Files which have been enqueued, by id.
+    std::vector<bool> enqueued(db->files.size());
 
     for (const auto& file : db->files)
-      if (file.def) {
-        if (matcher.IsMatch(file.def->path))
-          q.push(&file);
-        else
-          path_to_file[file.def->path] = &file;
-        for (const std::string& dependency : file.def->dependencies)
-          graph[dependency].push_back(file.def->path);
+      if (file.def && matcher.IsMatch(file.def->path)) {
+        q.push(&file);
+        enqueued[file.def->file.id] = true;
       }
 
     while (!q.empty()) {
@@ -76,11 +70,11 @@ struct Handler_CqueryFreshenIndex : BaseMessageHandler<In_CqueryFreshenIndex> {
         file_consumer_shared->Reset(file->def->path);
 
       if (request->params.dependencies)
-        for (const std::string& path : graph[file->def->path]) {
-          auto it = path_to_file.find(path);
-          if (it != path_to_file.end()) {
-            q.push(it->second);
-            path_to_file.erase(it);
+        for (RawId dependent : db->GetFileDependents(file->def->file)) {
+          const QueryFile& dependent_file = db->files[dependent];
+          if (dependent_file.def && !enqueued[dependent]) {
+            q.push(&dependent_file);
+            enqueued[dependent] = true;
           }
         }
     }
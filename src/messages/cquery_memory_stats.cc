@@ -0,0 +1,30 @@
+#include "memory_stats.h"
+#include "message_handler.h"
+#include "queue_manager.h"
+
+namespace {
+MethodType kMethodType = "$cquery/memoryStats";
+
+struct In_CqueryMemoryStats : public RequestInMessage {
+  MethodType GetMethodType() const override { return kMethodType; }
+};
+MAKE_REFLECT_STRUCT(In_CqueryMemoryStats, id);
+REGISTER_IN_MESSAGE(In_CqueryMemoryStats);
+
+struct Out_CqueryMemoryStats : public lsOutMessage<Out_CqueryMemoryStats> {
+  lsRequestId id;
+  MemoryStats result;
+};
+MAKE_REFLECT_STRUCT(Out_CqueryMemoryStats, jsonrpc, id, result);
+
+struct Handler_CqueryMemoryStats : BaseMessageHandler<In_CqueryMemoryStats> {
+  MethodType GetMethodType() const override { return kMethodType; }
+  void Run(In_CqueryMemoryStats* request) override {
+    Out_CqueryMemoryStats out;
+    out.id = request->id;
+    out.result = GetMemoryStats(db, working_files, clang_complete);
+    QueueManager::WriteStdout(kMethodType, out);
+  }
+};
+REGISTER_MESSAGE_HANDLER(Handler_CqueryMemoryStats);
+}  // namespace
@@ -614,13 +614,9 @@ struct Handler_Initialize : BaseMessageHandler<In_InitializeRequest> {
       diag_engine->Init();
       semantic_cache->Init();
 
-      // Open up / load the project.
-      project->Load(project_path);
-      time.ResetAndPrint("[perf] Loaded compilation entries (" +
-                         std::to_string(project->entries.size()) + " files)");
-
-      // Start indexer threads. Start this after loading the project, as that
-      // may take a long time. Indexer threads will emit status/progress
+      // Start indexer threads before loading the project, so that index
+      // requests are serviced while the remaining compilation entries are
+      // still being processed. Indexer threads will emit status/progress
       // reports.
       if (g_config->index.threads == 0) {
         // If the user has not specified how many indexers to run, try to
@@ -641,14 +637,18 @@ struct Handler_Initialize : BaseMessageHandler<In_InitializeRequest> {
         });
       }
 
-      // Start scanning include directories before dispatching project
-      // files, because that takes a long time.
+      // Open up / load the project, dispatching index requests as entries
+      // become available.
+      project->LoadAndIndex(project_path, QueueManager::instance(),
+                            working_files, request->id);
+      time.ResetAndPrint(
+          "[perf] Loaded compilation entries and dispatched initial index "
+          "requests (" +
+          std::to_string(project->entries.size()) + " files)");
+
+      // Scanning include directories requires the include directories
+      // discovered while loading the project.
       include_complete->Rescan();
-
-      time.Reset();
-      project->Index(QueueManager::instance(), working_files, request->id);
-      // We need to support multiple concurrent index processes.
-      time.ResetAndPrint("[perf] Dispatched initial index requests");
     }
   }
 };
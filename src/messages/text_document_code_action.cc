@@ -98,27 +98,19 @@ optional<QueryId::File> GetImplementationFile(QueryDatabase* db,
     }
   }
 
-  // No associated definition, scan the project for a file in the same
-  // directory with the same base-name.
-  AbsolutePath original_path = file->def->path;
-  std::string target_path = original_path.path;
-  size_t last = target_path.find_last_of('.');
-  if (last != std::string::npos) {
-    target_path = target_path.substr(0, last);
-  }
-
-  LOG_S(INFO) << "!! Looking for impl file that starts with " << target_path;
-
-  for (auto& entry : db->usr_to_file) {
-    const AbsolutePath& path = entry.first;
-
-    // Do not consider header files for implementation files.
-    // TODO: make file extensions configurable.
-    if (EndsWith(path.path, ".h") || EndsWith(path.path, ".hpp"))
-      continue;
-
-    if (StartsWith(path.path, target_path) && path != original_path) {
-      return entry.second;
+  // No associated definition. If this is a header, look for a source file in
+  // the same directory with the same base-name.
+  const AbsolutePath& original_path = file->def->path;
+  if (!EndsWithAny(original_path.path, g_config->codeAction.headerExtensions))
+    return nullopt;
+
+  std::vector<RawId> candidates = db->GetFilesWithSameStem(original_path);
+  for (const std::string& extension : g_config->codeAction.sourceExtensions) {
+    for (RawId candidate : candidates) {
+      const QueryFile& candidate_file = db->files[candidate];
+      if (candidate != file_id.id && candidate_file.def &&
+          EndsWith(candidate_file.def->path.path, extension))
+        return QueryId::File(candidate);
     }
   }
 
@@ -452,25 +444,22 @@ struct Handler_TextDocumentCodeAction
 
         std::unordered_set<std::string> include_absolute_paths;
 
-        // Find include candidate strings.
-        for (size_t i = 0; i < db->symbols.size(); ++i) {
-          if (include_absolute_paths.size() > kMaxResults)
-            break;
-          if (db->GetSymbolDetailedName(i).find(include_query) ==
-              std::string::npos)
-            continue;
-
-          optional<QueryId::File> decl_file_id =
-              GetDeclarationFileForSymbol(db, db->symbols[i]);
-          if (!decl_file_id)
-            continue;
-
-          QueryFile& decl_file = db->files[decl_file_id->id];
-          if (!decl_file.def)
-            continue;
-
-          include_absolute_paths.insert(decl_file.def->path);
-        }
+        // Find include candidate strings. Symbols named exactly like the
+        // identifier come first, then those whose name starts with it.
+        db->FindSymbolsByShortName(
+            include_query, true /*include_prefix_matches*/, [&](RawId i) {
+              optional<QueryId::File> decl_file_id =
+                  GetDeclarationFileForSymbol(db, db->symbols[i]);
+              if (!decl_file_id)
+                return true;
+
+              QueryFile& decl_file = db->files[decl_file_id->id];
+              if (!decl_file.def)
+                return true;
+
+              include_absolute_paths.insert(decl_file.def->path);
+              return include_absolute_paths.size() < kMaxResults;
+            });
 
         // Build include strings.
         std::unordered_set<std::string> include_insert_strings;
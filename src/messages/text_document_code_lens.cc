@@ -44,7 +44,8 @@ void AddCodeLens(const char* singular,
                  const char* plural,
                  CommonCodeLensParams* common,
                  QueryId::LexicalRef ref,
-                 const std::vector<QueryId::LexicalRef>& uses,
+                 SymbolIdx sym,
+                 lsCodeLensRefs::Type type,
                  bool force_display) {
   TCodeLens code_lens;
   optional<lsRange> range = GetLsRange(common->working_file, ref.range);
@@ -58,27 +59,37 @@ void AddCodeLens(const char* singular,
   code_lens.command->arguments.uri = GetLsDocumentUri(common->db, ref.file);
   code_lens.command->arguments.position = code_lens.range.start;
 
-  // Add unique uses.
-  std::unordered_set<lsLocation> unique_uses;
-  for (QueryId::LexicalRef use1 : uses) {
-    optional<lsLocation> location =
-        GetLsLocation(common->db, common->working_files, use1);
-    if (!location)
-      continue;
-    unique_uses.insert(*location);
+  lsCodeLensRefs refs;
+  refs.symbol = sym;
+  refs.type = type;
+  size_t num_usages;
+  if (g_config->codeLens.lazyLocations) {
+    // Only count the locations; workspace/executeCommand resolves them.
+    num_usages = CountCodeLensRefs(common->db, common->working_files, refs);
+    code_lens.command->arguments.refs = refs;
+  } else {
+    // Add unique uses.
+    std::unordered_set<lsLocation> unique_uses;
+    for (QueryId::LexicalRef use1 : GetCodeLensRefs(common->db, refs)) {
+      optional<lsLocation> location =
+          GetLsLocation(common->db, common->working_files, use1);
+      if (!location)
+        continue;
+      unique_uses.insert(*location);
+    }
+    code_lens.command->arguments.locations.assign(unique_uses.begin(),
+                                                  unique_uses.end());
+    num_usages = unique_uses.size();
   }
-  code_lens.command->arguments.locations.assign(unique_uses.begin(),
-                                                unique_uses.end());
 
   // User visible label
-  size_t num_usages = unique_uses.size();
   code_lens.command->title = std::to_string(num_usages) + " ";
   if (num_usages == 1)
     code_lens.command->title += singular;
   else
     code_lens.command->title += plural;
 
-  if (force_display || unique_uses.size() > 0)
+  if (force_display || num_usages > 0)
     common->result->push_back(code_lens);
 }
 
@@ -119,13 +130,13 @@ struct Handler_TextDocumentCodeLens
           const QueryType::Def* def = type.AnyDef();
           if (!def || def->kind == lsSymbolKind::Namespace)
             continue;
-          AddCodeLens("ref", "refs", &common, OffsetStartColumn(ref, 0),
-                      type.uses, true /*force_display*/);
+          AddCodeLens("ref", "refs", &common, OffsetStartColumn(ref, 0), sym,
+                      lsCodeLensRefs::Type::Uses, true /*force_display*/);
           AddCodeLens("derived", "derived", &common, OffsetStartColumn(ref, 1),
-                      GetDeclarations(db, type.derived),
+                      sym, lsCodeLensRefs::Type::Derived,
                       false /*force_display*/);
-          AddCodeLens("var", "vars", &common, OffsetStartColumn(ref, 2),
-                      GetDeclarations(db, type.instances),
+          AddCodeLens("var", "vars", &common, OffsetStartColumn(ref, 2), sym,
+                      lsCodeLensRefs::Type::Instances,
                       false /*force_display*/);
           break;
         }
@@ -148,33 +159,33 @@ struct Handler_TextDocumentCodeLens
             return *def;
           };
 
-          std::vector<QueryId::LexicalRef> base_callers =
-              GetRefsForAllBases(db, func);
-          std::vector<QueryId::LexicalRef> derived_callers =
-              GetRefsForAllDerived(db, func);
-          if (base_callers.empty() && derived_callers.empty()) {
+          bool has_base_callers = !GetRefsForAllBases(db, func).empty();
+          bool has_derived_callers = !GetRefsForAllDerived(db, func).empty();
+          if (!has_base_callers && !has_derived_callers) {
             QueryId::LexicalRef loc = try_ensure_spelling(ref);
             AddCodeLens("call", "calls", &common,
-                        OffsetStartColumn(loc, offset++), func.uses,
-                        true /*force_display*/);
+                        OffsetStartColumn(loc, offset++), sym,
+                        lsCodeLensRefs::Type::Uses, true /*force_display*/);
           } else {
             QueryId::LexicalRef loc = try_ensure_spelling(ref);
             AddCodeLens("direct call", "direct calls", &common,
-                        OffsetStartColumn(loc, offset++), func.uses,
-                        false /*force_display*/);
-            if (!base_callers.empty())
+                        OffsetStartColumn(loc, offset++), sym,
+                        lsCodeLensRefs::Type::Uses, false /*force_display*/);
+            if (has_base_callers)
               AddCodeLens("base call", "base calls", &common,
-                          OffsetStartColumn(loc, offset++), base_callers,
+                          OffsetStartColumn(loc, offset++), sym,
+                          lsCodeLensRefs::Type::BaseCalls,
                           false /*force_display*/);
-            if (!derived_callers.empty())
+            if (has_derived_callers)
               AddCodeLens("derived call", "derived calls", &common,
-                          OffsetStartColumn(loc, offset++), derived_callers,
+                          OffsetStartColumn(loc, offset++), sym,
+                          lsCodeLensRefs::Type::DerivedCalls,
                           false /*force_display*/);
           }
 
-          AddCodeLens(
-              "derived", "derived", &common, OffsetStartColumn(ref, offset++),
-              GetDeclarations(db, func.derived), false /*force_display*/);
+          AddCodeLens("derived", "derived", &common,
+                      OffsetStartColumn(ref, offset++), sym,
+                      lsCodeLensRefs::Type::Derived, false /*force_display*/);
 
           // "Base"
           if (def->bases.size() == 1) {
@@ -200,9 +211,8 @@ struct Handler_TextDocumentCodeLens
               }
             }
           } else {
-            AddCodeLens("base", "base", &common, OffsetStartColumn(ref, 1),
-                        GetDeclarations(db, def->bases),
-                        false /*force_display*/);
+            AddCodeLens("base", "base", &common, OffsetStartColumn(ref, 1), sym,
+                        lsCodeLensRefs::Type::Bases, false /*force_display*/);
           }
 
           break;
@@ -219,8 +229,8 @@ struct Handler_TextDocumentCodeLens
           if (def->kind == lsSymbolKind::Macro)
             force_display = false;
 
-          AddCodeLens("ref", "refs", &common, OffsetStartColumn(ref, 0),
-                      var.uses, force_display);
+          AddCodeLens("ref", "refs", &common, OffsetStartColumn(ref, 0), sym,
+                      lsCodeLensRefs::Type::Uses, force_display);
           break;
         }
         case SymbolKind::File:
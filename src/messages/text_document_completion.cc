@@ -367,14 +367,10 @@ struct Handler_TextDocumentCompletion : MessageHandler {
                                           g_config->completion.filterAndSort);
         }
       } else if (result.keyword.compare("include") == 0) {
-        {
-          // do include completion
-          std::unique_lock<std::mutex> lock(
-              include_complete->completion_items_mutex, std::defer_lock);
-          if (include_complete->is_scanning)
-            lock.lock();
-          out.result.items = include_complete->completion_items;
-        }
+        // Only items which can pass FilterAndSortCompletionResponse are
+        // copied out of the index.
+        out.result.items = include_complete->FindMatchingItems(
+            g_config->completion.filterAndSort ? result.pattern : "");
         FilterAndSortCompletionResponse(&out, result.pattern, has_open_paren,
                                         g_config->completion.filterAndSort);
         DecorateIncludePaths(result.match, &out.result.items);
@@ -125,15 +125,14 @@ struct Handler_TextDocumentDefinition
             short_query = query.substr(pos + 1);
         }
 
-        // For symbols whose short/detailed names contain |query| as a
-        // substring, we use the tuple <length difference, negative position,
-        // not in the same file, line distance> to find the best match.
+        // Candidates are the symbols whose short name is |short_query|, looked
+        // up in the short name index. For these we use the tuple <length
+        // difference, negative position, not in the same file, line distance>
+        // to find the best match, where the first two compare |query| with the
+        // detailed name if it is qualified.
         std::tuple<int, int, bool, int> best_score{INT_MAX, 0, true, 0};
         int best_i = -1;
-        for (int i = 0; i < (int)db->symbols.size(); ++i) {
-          if (db->symbols[i].kind == SymbolKind::Invalid)
-            continue;
-
+        for (RawId i : db->GetSymbolsByShortName(short_query)) {
           std::string_view name = short_query.size() < query.size()
                                       ? db->GetSymbolDetailedName(i)
                                       : db->GetSymbolShortName(i);
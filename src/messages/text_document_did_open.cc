@@ -54,7 +54,8 @@ struct Handler_TextDocumentDidOpen
     FindFileOrFail(db, project, nullopt, path, &file);
     if (file && file->def) {
       EmitInactiveLines(working_file, file->def->inactive_regions);
-      EmitSemanticHighlighting(db, semantic_cache, working_file, file);
+      EmitSemanticHighlighting(db, semantic_cache, working_file, file,
+                               true /*full*/);
     }
 
     time.ResetAndPrint(
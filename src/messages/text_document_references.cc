@@ -54,34 +54,36 @@ struct Handler_TextDocumentReferences
     for (const QueryId::SymbolRef& sym :
          FindSymbolsAtLocation(working_file, file, request->params.position)) {
       // Found symbol. Return references.
+      std::vector<QueryId::LexicalRef> refs;
       EachOccurrenceWithParent(
           db, sym, request->params.context.includeDeclaration,
           [&](QueryId::LexicalRef ref, lsSymbolKind parent_kind) {
             if (ref.role & request->params.context.role)
-              if (optional<lsLocation> ls_loc =
-                      GetLsLocation(db, working_files, ref)) {
-                out.result.push_back(*ls_loc);
-              }
+              refs.push_back(ref);
           });
+      out.result = GetLsLocations(db, working_files, refs);
       break;
     }
 
     if (out.result.empty())
       for (const IndexInclude& include : file->def->includes)
         if (include.line == request->params.position.line) {
-          // |include| is the line the cursor is on.
-          for (QueryFile& file1 : db->files)
-            if (file1.def)
-              for (const IndexInclude& include1 : file1.def->includes)
-                if (include1.resolved_path == include.resolved_path) {
-                  // Another file |file1| has the same include line.
-                  lsLocation result;
-                  result.uri = lsDocumentUri::FromPath(file1.def->path);
-                  result.range.start.line = result.range.end.line =
-                      include1.line;
-                  out.result.push_back(std::move(result));
-                  break;
-                }
+          // |include| is the line the cursor is on. Report the first line of
+          // each file which includes the same file.
+          optional<RawId> last_file;
+          for (const QueryDatabase::IncludeLocation& include1 :
+               db->GetIncludesOf(include.resolved_path)) {
+            if (include1.file == last_file)
+              continue;
+            last_file = include1.file;
+            QueryFile& file1 = db->files[include1.file];
+            if (!file1.def)
+              continue;
+            lsLocation result;
+            result.uri = lsDocumentUri::FromPath(file1.def->path);
+            result.range.start.line = result.range.end.line = include1.line;
+            out.result.push_back(std::move(result));
+          }
           break;
         }
 
@@ -28,14 +28,12 @@ struct Handler_WorkspaceDidChangeConfiguration
   MethodType GetMethodType() const override { return kMethodType; }
   void Run(In_WorkspaceDidChangeConfiguration* request) override {
     Timer time;
-    project->Load(g_config->projectRoot);
-    time.ResetAndPrint("[perf] Loaded compilation entries (" +
-                       std::to_string(project->entries.size()) + " files)");
-
-    time.Reset();
-    project->Index(QueueManager::instance(), working_files, lsRequestId());
+    project->LoadAndIndex(g_config->projectRoot, QueueManager::instance(),
+                          working_files, lsRequestId());
     time.ResetAndPrint(
-        "[perf] Dispatched workspace/didChangeConfiguration index requests");
+        "[perf] Loaded compilation entries and dispatched "
+        "workspace/didChangeConfiguration index requests (" +
+        std::to_string(project->entries.size()) + " files)");
 
     clang_complete->FlushAllSessions();
     LOG_S(INFO) << "Flushed all clang complete sessions";
@@ -1,5 +1,6 @@
 #include "cache_manager.h"
 #include "clang_complete.h"
+#include "include_complete.h"
 #include "message_handler.h"
 #include "project.h"
 #include "queue_manager.h"
@@ -7,6 +8,8 @@
 
 #include <loguru/loguru.hpp>
 
+#include <unordered_set>
+
 namespace {
 MethodType kMethodType = "workspace/didChangeWatchedFiles";
 
@@ -42,11 +45,24 @@ struct Handler_WorkspaceDidChangeWatchedFiles
     : BaseMessageHandler<In_WorkspaceDidChangeWatchedFiles> {
   MethodType GetMethodType() const override { return kMethodType; }
   void Run(In_WorkspaceDidChangeWatchedFiles* request) override {
+    // Project entries which have been enqueued for this notification.
+    std::unordered_set<std::string> enqueued;
+    // Changed files which are not project entries, ie, headers.
+    std::vector<AbsolutePath> headers;
+
     for (lsFileEvent& event : request->params.changes) {
       AbsolutePath path = event.uri.GetAbsolutePath();
+      if (event.type == lsFileChangeType::Created)
+        include_complete->AddFile(path);
+      else if (event.type == lsFileChangeType::Deleted)
+        include_complete->RemoveFile(path);
+
       auto it = project->absolute_path_to_entry_index_.find(path);
-      if (it == project->absolute_path_to_entry_index_.end())
+      if (it == project->absolute_path_to_entry_index_.end()) {
+        headers.push_back(path);
         continue;
+      }
+      enqueued.insert(path);
       const Project::Entry& entry = project->entries[it->second];
       bool is_interactive =
           working_files->GetFileByFilename(entry.filename) != nullptr;
@@ -69,7 +85,72 @@ struct Handler_WorkspaceDidChangeWatchedFiles
           break;
       }
     }
+
+    if (!headers.empty())
+      ReindexDependents(headers, &enqueued);
+  }
+
+  // Headers are only indexed as part of a translation unit, so reparse the
+  // project entries which depend on them.
+  void ReindexDependents(const std::vector<AbsolutePath>& headers,
+                         std::unordered_set<std::string>* enqueued) {
+    std::vector<RawId> stack;
+    std::unordered_set<RawId> seen;
+    for (const AbsolutePath& header : headers) {
+      auto it = db->usr_to_file.find(header);
+      if (it == db->usr_to_file.end())
+        continue;
+      // Let the next translation unit which includes the header index it.
+      file_consumer_shared->Reset(header);
+      if (seen.insert(it->second.id).second)
+        stack.push_back(it->second.id);
+    }
+
+    while (!stack.empty()) {
+      RawId id = stack.back();
+      stack.pop_back();
+      for (RawId dependent : db->GetFileDependents(QueryId::File(id))) {
+        if (seen.insert(dependent).second)
+          stack.push_back(dependent);
+      }
+
+      const QueryFile& file = db->files[id];
+      if (!file.def)
+        continue;
+      const std::string& path = file.def->path;
+      auto it = project->absolute_path_to_entry_index_.find(path);
+      if (it == project->absolute_path_to_entry_index_.end() ||
+          !enqueued->insert(path).second)
+        continue;
+      const Project::Entry& entry = project->entries[it->second];
+      bool is_interactive =
+          working_files->GetFileByFilename(entry.filename) != nullptr;
+      QueueManager::instance()->index_request.Enqueue(
+          Index_Request(entry.filename, entry.args, is_interactive, nullopt,
+                        ICacheManager::Make()),
+          false /*priority*/);
+    }
   }
 };
 REGISTER_MESSAGE_HANDLER(Handler_WorkspaceDidChangeWatchedFiles);
 }  // namespace
+
+std::unique_ptr<InMessage> MakeDidChangeWatchedFiles(
+    const std::vector<AbsolutePath>& changed,
+    const std::vector<AbsolutePath>& deleted) {
+  auto message = std::make_unique<In_WorkspaceDidChangeWatchedFiles>();
+  for (const AbsolutePath& path : changed) {
+    lsFileEvent event;
+    event.uri = lsDocumentUri::FromPath(path);
+    // Created files are also added to include completion.
+    event.type = lsFileChangeType::Created;
+    message->params.changes.push_back(event);
+  }
+  for (const AbsolutePath& path : deleted) {
+    lsFileEvent event;
+    event.uri = lsDocumentUri::FromPath(path);
+    event.type = lsFileChangeType::Deleted;
+    message->params.changes.push_back(event);
+  }
+  return message;
+}
@@ -31,7 +31,14 @@ struct Handler_WorkspaceExecuteCommand
     } else if (params.command == "cquery._autoImplement") {
     } else if (params.command == "cquery._insertInclude") {
     } else if (params.command == "cquery.showReferences") {
-      out.result = params.arguments.locations;
+      if (params.arguments.refs) {
+        // Code lens from Config::CodeLens::lazyLocations. This must match
+        // CountCodeLensRefs, which computed the count in the title.
+        out.result = GetLsLocations(
+            db, working_files, GetCodeLensRefs(db, *params.arguments.refs));
+      } else {
+        out.result = params.arguments.locations;
+      }
     }
 
     QueueManager::WriteStdout(kMethodType, out);
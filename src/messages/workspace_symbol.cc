@@ -77,13 +77,33 @@ struct Handler_WorkspaceSymbol : BaseMessageHandler<In_WorkspaceSymbol> {
     // db->detailed_names indices of each lsSymbolInformation in out.result
     std::vector<int> result_indices;
     std::vector<lsSymbolInformation> unsorted_results;
-    inserted_results.reserve(g_config->workspaceSymbol.maxNum);
-    result_indices.reserve(g_config->workspaceSymbol.maxNum);
+    size_t max_num = g_config->workspaceSymbol.maxNum;
+    inserted_results.reserve(max_num);
+    result_indices.reserve(max_num);
+
+    // Find symbols whose name starts with the query. These come from the
+    // short name index, so when there are enough of them no symbol is scanned.
+    if (!query.empty()) {
+      db->FindSymbolsByShortName(
+          query, true /*include_prefix_matches*/, [&](RawId i) {
+            // Do not show the same entry twice.
+            if (!inserted_results
+                     .insert(std::string(db->GetSymbolDetailedName(i)))
+                     .second)
+              return true;
+
+            if (InsertSymbolIntoResult(db, working_files, db->symbols[i],
+                                       &unsorted_results))
+              result_indices.push_back(i);
+            return unsorted_results.size() < max_num;
+          });
+    }
 
     // We use detailed_names without parameters for matching.
 
     // Find exact substring matches.
-    for (int i = 0; i < db->symbols.size(); ++i) {
+    for (int i = 0;
+         i < db->symbols.size() && unsorted_results.size() < max_num; ++i) {
       std::string_view detailed_name = db->GetSymbolDetailedName(i);
       if (detailed_name.find(query) != std::string::npos) {
         // Do not show the same entry twice.
@@ -93,14 +113,14 @@ struct Handler_WorkspaceSymbol : BaseMessageHandler<In_WorkspaceSymbol> {
         if (InsertSymbolIntoResult(db, working_files, db->symbols[i],
                                    &unsorted_results)) {
           result_indices.push_back(i);
-          if (unsorted_results.size() >= g_config->workspaceSymbol.maxNum)
+          if (unsorted_results.size() >= max_num)
             break;
         }
       }
     }
 
     // Find subsequence matches.
-    if (unsorted_results.size() < g_config->workspaceSymbol.maxNum) {
+    if (unsorted_results.size() < max_num) {
       std::string query_without_space;
       query_without_space.reserve(query.size());
       for (char c : query)
@@ -118,7 +138,7 @@ struct Handler_WorkspaceSymbol : BaseMessageHandler<In_WorkspaceSymbol> {
           if (InsertSymbolIntoResult(db, working_files, db->symbols[i],
                                      &unsorted_results)) {
             result_indices.push_back(i);
-            if (unsorted_results.size() >= g_config->workspaceSymbol.maxNum)
+            if (unsorted_results.size() >= max_num)
               break;
           }
         }
@@ -5,6 +5,7 @@
 #include <optional.h>
 #include <string_view.h>
 
+#include <functional>
 #include <memory>
 #include <string>
 #include <vector>
@@ -52,6 +53,15 @@ void CopyFileTo(const AbsolutePath& destination, const AbsolutePath& source);
 
 bool IsSymLink(const AbsolutePath& path);
 
+// Calls |handler| for every entry in |directory| except "." and "..". |is_dir|
+// follows symbolic links. Where the file system reports entry types, no stat
+// call is made for regular files and directories. Returns false if
+// |directory| cannot be opened.
+bool ReadDirectory(
+    const std::string& directory,
+    const std::function<void(const char* name, bool is_dir, bool is_symlink)>&
+        handler);
+
 // Returns any clang arguments that are specific to the current platform.
 std::vector<const char*> GetPlatformClangArguments();
 
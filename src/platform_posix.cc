@@ -281,6 +281,53 @@ bool IsSymLink(const AbsolutePath& path) {
   return lstat(path.path.c_str(), &buf) == 0 && S_ISLNK(buf.st_mode);
 }
 
+bool ReadDirectory(
+    const std::string& directory,
+    const std::function<void(const char* name, bool is_dir, bool is_symlink)>&
+        handler) {
+  int fd = open(directory.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+  if (fd < 0)
+    return false;
+  DIR* dir = fdopendir(fd);
+  if (!dir) {
+    close(fd);
+    return false;
+  }
+
+  // readdir is backed by getdents64 on Linux, which fills |d_type| on all
+  // common file systems. Only symbolic links and file systems which do not
+  // report types need an extra fstatat.
+  while (struct dirent* entry = readdir(dir)) {
+    const char* name = entry->d_name;
+    if (name[0] == '.' &&
+        (name[1] == '\0' || (name[1] == '.' && name[2] == '\0')))
+      continue;
+
+    bool is_dir = false;
+    bool is_symlink = false;
+    unsigned char type = DT_UNKNOWN;
+#if defined(_DIRENT_HAVE_D_TYPE) || defined(__APPLE__) || \
+    defined(__FreeBSD__) || defined(__OpenBSD__)
+    type = entry->d_type;
+#endif
+    if (type == DT_DIR) {
+      is_dir = true;
+    } else if (type == DT_UNKNOWN || type == DT_LNK) {
+      struct stat buf;
+      if (fstatat(dirfd(dir), name, &buf, AT_SYMLINK_NOFOLLOW) != 0)
+        continue;
+      is_symlink = S_ISLNK(buf.st_mode);
+      if (is_symlink && fstatat(dirfd(dir), name, &buf, 0) != 0)
+        continue;
+      is_dir = S_ISDIR(buf.st_mode);
+    }
+    handler(name, is_dir, is_symlink);
+  }
+
+  closedir(dir);
+  return true;
+}
+
 std::vector<const char*> GetPlatformClangArguments() {
   return {};
 }
@@ -236,6 +236,33 @@ bool IsSymLink(const AbsolutePath& path) {
   return false;
 }
 
+bool ReadDirectory(
+    const std::string& directory,
+    const std::function<void(const char* name, bool is_dir, bool is_symlink)>&
+        handler) {
+  std::string pattern = directory;
+  EnsureEndsInSlash(pattern);
+  pattern += '*';
+
+  WIN32_FIND_DATAA data;
+  HANDLE find = FindFirstFileExA(pattern.c_str(), FindExInfoBasic, &data,
+                                 FindExSearchNameMatch, nullptr,
+                                 FIND_FIRST_EX_LARGE_FETCH);
+  if (find == INVALID_HANDLE_VALUE)
+    return false;
+  do {
+    const char* name = data.cFileName;
+    if (name[0] == '.' &&
+        (name[1] == '\0' || (name[1] == '.' && name[2] == '\0')))
+      continue;
+    // Like IsSymLink, reparse points are not treated as symbolic links.
+    handler(name, (data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) != 0,
+            false /*is_symlink*/);
+  } while (FindNextFileA(find, &data));
+  FindClose(find);
+  return true;
+}
+
 std::vector<const char*> GetPlatformClangArguments() {
   //
   // Found by executing
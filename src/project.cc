@@ -3,19 +3,21 @@
 #include "c_cpp_properties.h"
 #include "cache_manager.h"
 #include "clang_system_include_extractor.h"
-#include "clang_utils.h"
 #include "compiler.h"
 #include "language.h"
 #include "match.h"
 #include "platform.h"
 #include "queue_manager.h"
 #include "serializers/json.h"
+#include "serializers/msgpack.h"
 #include "timer.h"
 #include "utils.h"
 #include "working_files.h"
 
-#include <clang-c/CXCompilationDatabase.h>
 #include <doctest/doctest.h>
+#include <rapidjson/error/en.h>
+#include <rapidjson/filereadstream.h>
+#include <rapidjson/reader.h>
 #include <rapidjson/writer.h>
 #include <loguru.hpp>
 
@@ -24,10 +26,18 @@
 #endif
 
 #include <optional.h>
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
 #include <fstream>
+#include <future>
 #include <iostream>
 #include <limits>
+#include <mutex>
 #include <sstream>
+#include <thread>
 #include <unordered_set>
 #include <vector>
 
@@ -40,34 +50,45 @@ struct CompileCommandsEntry {
   std::vector<std::string> args;
 };
 MAKE_REFLECT_STRUCT(CompileCommandsEntry, directory, file, command, args);
+MAKE_REFLECT_STRUCT(Project::Entry, filename, args, is_inferred);
 
 namespace {
 
 bool g_disable_normalize_path_for_test = false;
 
+// Thread-safe, since compilation entries are processed in parallel. The lock
+// is not held while normalizing, so two threads may normalize the same path.
 struct NormalizationCache {
+  std::mutex mutex;
   // input path -> normalized path
   std::unordered_map<std::string, AbsolutePath> paths;
 
   AbsolutePath Get(const std::string& path) {
-    auto it = paths.find(path);
-    if (it != paths.end())
-      return it->second;
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      auto it = paths.find(path);
+      if (it != paths.end())
+        return it->second;
+    }
 
+    AbsolutePath result = Normalize(path);
+    std::lock_guard<std::mutex> lock(mutex);
+    paths.emplace(path, result);
+    return result;
+  }
+
+ private:
+  static AbsolutePath Normalize(const std::string& path) {
     if (g_disable_normalize_path_for_test) {
       // Add a & so we can test to verify a path is normalized.
-      paths[path] = AbsolutePath("&" + path);
-      return paths[path];
+      return AbsolutePath("&" + path);
     }
 
     optional<AbsolutePath> normalized = NormalizePath(path);
-    if (normalized) {
-      paths[path] = *normalized;
+    if (normalized)
       return *normalized;
-    }
 
     LOG_S(WARNING) << "Failed to normalize " << path;
-    paths[path] = AbsolutePath(path);
     return AbsolutePath(path);
   }
 };
@@ -79,11 +100,123 @@ enum class ProjectMode {
   ExternalCommand
 };
 
+struct CompilerDriverStamp {
+  // The driver as it was passed to FindSystemIncludeDirectories, ie, either an
+  // absolute path or a name which is looked up in PATH.
+  std::string driver;
+  // -1 if the driver could not be found.
+  int64_t last_modification_time = -1;
+};
+MAKE_REFLECT_STRUCT(CompilerDriverStamp, driver, last_modification_time);
+
+// Resolves |driver| like the shell would and returns its modification time.
+CompilerDriverStamp GetCompilerDriverStamp(const std::string& driver) {
+  CompilerDriverStamp stamp;
+  stamp.driver = driver;
+  if (IsAbsolutePath(driver)) {
+    stamp.last_modification_time =
+        GetLastModificationTime(AbsolutePath(driver, false /*validate*/))
+            .value_or(-1);
+    return stamp;
+  }
+
+#if defined(_WIN32)
+  const char kPathSeparator = ';';
+#else
+  const char kPathSeparator = ':';
+#endif
+  const char* path_env = getenv("PATH");
+  for (std::string dir : SplitString(path_env ? path_env : "",
+                                     std::string(1, kPathSeparator))) {
+    if (dir.empty())
+      continue;
+    EnsureEndsInSlash(dir);
+    optional<int64_t> mtime =
+        GetLastModificationTime(AbsolutePath(dir + driver, false /*validate*/));
+    if (mtime) {
+      stamp.last_modification_time = *mtime;
+      break;
+    }
+  }
+  return stamp;
+}
+
+bool CompilerDriversUnchanged(const std::vector<CompilerDriverStamp>& stamps) {
+  for (const CompilerDriverStamp& stamp : stamps) {
+    if (GetCompilerDriverStamp(stamp.driver).last_modification_time !=
+        stamp.last_modification_time)
+      return false;
+  }
+  return true;
+}
+
+// Reads a value written by WriteCacheFile. Returns nullopt if the file does not
+// exist, cannot be deserialized or was written with a different |version|.
+template <typename T>
+optional<T> ReadCacheFile(const std::string& path, int version) {
+  optional<std::string> content = ReadContent(AbsolutePath(path, false));
+  if (!content || content->empty())
+    return nullopt;
+
+  T value;
+  try {
+    msgpack::unpacker upk;
+    upk.reserve_buffer(content->size());
+    memcpy(upk.buffer(), content->data(), content->size());
+    upk.buffer_consumed(content->size());
+    MessagePackReader reader(&upk);
+    int file_version;
+    Reflect(reader, file_version);
+    if (file_version != version)
+      return nullopt;
+    Reflect(reader, value);
+  } catch (std::exception& e) {
+    LOG_S(INFO) << "Failed to deserialize " << path << ": " << e.what();
+    return nullopt;
+  }
+  return value;
+}
+
+template <typename T>
+void WriteCacheFile(const std::string& path, int version, T& value) {
+  msgpack::sbuffer buf;
+  msgpack::packer<msgpack::sbuffer> pk(&buf);
+  MessagePackWriter writer(&pk);
+  Reflect(writer, version);
+  Reflect(writer, value);
+  WriteToFile(path, std::string(buf.data(), buf.size()));
+}
+
+// Bump this whenever the layout of the system include cache changes.
+const int kSystemIncludesCacheVersion = 1;
+
+// Result of system include discovery for one toolchain. These are saved to the
+// cache directory and shared by all projects.
+struct SystemIncludesCacheEntry {
+  // See GetSystemIncludes.
+  std::string key;
+  // The flags are only valid as long as none of the drivers has changed.
+  std::vector<CompilerDriverStamp> compiler_drivers;
+  // System include directory and preprocessor define flags.
+  std::vector<std::string> flags;
+};
+MAKE_REFLECT_STRUCT(SystemIncludesCacheEntry, key, compiler_drivers, flags);
+
 struct ProjectConfig {
-  std::unordered_map<LanguageId, std::vector<std::string>>
+  // Guards |discovered_system_includes|, |system_includes_cache|,
+  // |compiler_drivers|, |quote_dirs| and |angle_dirs|, which are updated while
+  // compilation entries are processed in parallel.
+  std::mutex mutex;
+  // System include and define flags by toolchain key. Threads which need a
+  // toolchain that is still being discovered wait on its future, while
+  // different toolchains are discovered in parallel.
+  std::unordered_map<std::string, std::shared_future<std::vector<std::string>>>
       discovered_system_includes;
-  std::unordered_map<LanguageId, std::vector<std::string>>
-      discovered_system_defines;
+  // Discovery results of previous runs, by toolchain key.
+  std::unordered_map<std::string, SystemIncludesCacheEntry>
+      system_includes_cache;
+  // True if |system_includes_cache| has new entries which should be saved.
+  bool system_includes_cache_dirty = false;
   std::unordered_set<Directory> quote_dirs;
   std::unordered_set<Directory> angle_dirs;
   std::vector<std::string> extra_flags;
@@ -91,6 +224,8 @@ struct ProjectConfig {
   std::string resource_dir;
   ProjectMode mode = ProjectMode::CompileCommandsJson;
   NormalizationCache normalization_cache;
+  // Compiler drivers which system includes were discovered with.
+  std::unordered_set<std::string> compiler_drivers;
 };
 
 const std::vector<std::string>& GetSystemIncludes(
@@ -99,14 +234,9 @@ const std::vector<std::string>& GetSystemIncludes(
     LanguageId language,
     const std::string& working_directory,
     const std::vector<std::string>& flags) {
-  auto it = project_config->discovered_system_includes.find(language);
-  if (it != project_config->discovered_system_includes.end())
-    return it->second;
-
-  if (g_disable_normalize_path_for_test || !g_config->discoverSystemIncludes) {
-    project_config->discovered_system_includes[language] = {};
-    return project_config->discovered_system_includes[language];
-  }
+  static const std::vector<std::string> kNoFlags;
+  if (g_disable_normalize_path_for_test || !g_config->discoverSystemIncludes)
+    return kNoFlags;
 
   std::string language_string;
   switch (language) {
@@ -163,32 +293,62 @@ const std::vector<std::string>& GetSystemIncludes(
     compiler_drivers.emplace_back("clang++");
     compiler_drivers.emplace_back("g++");
   }
+  // Relative paths in |extra_flags| depend on the working directory.
+  std::string key = language_string + '\n' + StringJoin(compiler_drivers, "\n") +
+                    '\n' + StringJoin(extra_flags, "\n");
+  if (!extra_flags.empty())
+    key += '\n' + working_directory;
+
+  std::promise<std::vector<std::string>> promise;
+  std::shared_future<std::vector<std::string>> result;
+  optional<SystemIncludesCacheEntry> cached;
+  {
+    std::lock_guard<std::mutex> lock(project_config->mutex);
+    auto it = project_config->discovered_system_includes.find(key);
+    if (it != project_config->discovered_system_includes.end())
+      return it->second.get();
+
+    result = promise.get_future().share();
+    project_config->discovered_system_includes.emplace(key, result);
+    project_config->compiler_drivers.insert(compiler_drivers.begin(),
+                                            compiler_drivers.end());
+    auto cache_it = project_config->system_includes_cache.find(key);
+    if (cache_it != project_config->system_includes_cache.end())
+      cached = cache_it->second;
+  }
+
+  // The lock is not held from here on, so that discovery for other toolchains
+  // runs in parallel.
+  if (cached && CompilerDriversUnchanged(cached->compiler_drivers)) {
+    promise.set_value(cached->flags);
+    return result.get();
+  }
 
-  project_config->discovered_system_includes[language] =
-      FindSystemIncludeDirectories(compiler_drivers, language_string,
-                                   working_directory, extra_flags);
-  project_config->discovered_system_defines[language] =
-      FindSystemDefines(compiler_drivers, language_string, working_directory, extra_flags);
+  std::vector<std::string> includes = FindSystemIncludeDirectories(
+      compiler_drivers, language_string, working_directory, extra_flags);
+  std::vector<std::string> defines = FindSystemDefines(
+      compiler_drivers, language_string, working_directory, extra_flags);
   LOG_S(INFO) << "Using system include directory flags\n  "
-              << StringJoin(
-                     project_config->discovered_system_includes[language],
-                     "\n  ");
+              << StringJoin(includes, "\n  ");
   LOG_S(INFO) << "Using system preprocessor defines\n  "
-              << StringJoin(
-                     project_config->discovered_system_defines[language],
-                     "\n  ");
+              << StringJoin(defines, "\n  ");
   LOG_S(INFO) << "To disable this set the discoverSystemIncludes config "
               << "option to false.";
-
-  project_config->discovered_system_includes[language].reserve(
-      project_config->discovered_system_includes[language].size()
-      + project_config->discovered_system_defines[language].size());
-
-  for (const auto& element : project_config->discovered_system_defines[language]) {
-      project_config->discovered_system_includes[language].emplace_back(element);
+  includes.insert(includes.end(), defines.begin(), defines.end());
+
+  SystemIncludesCacheEntry entry;
+  entry.key = key;
+  for (const std::string& driver : compiler_drivers)
+    entry.compiler_drivers.push_back(GetCompilerDriverStamp(driver));
+  entry.flags = includes;
+  {
+    std::lock_guard<std::mutex> lock(project_config->mutex);
+    project_config->system_includes_cache[key] = std::move(entry);
+    project_config->system_includes_cache_dirty = true;
   }
 
-  return project_config->discovered_system_includes[language];
+  promise.set_value(std::move(includes));
+  return result.get();
 }
 
 // TODO: See
@@ -299,6 +459,7 @@ Project::Entry GetCompilationEntryFromCompileCommandEntry(
   }
   if (args.empty())
     return result;
+  std::vector<std::string> result_args;
 
   std::string first_arg = args[0];
   // Windows' filesystem is not case sensitive, so we compare only
@@ -346,26 +507,30 @@ Project::Entry GetCompilationEntryFromCompileCommandEntry(
   std::string compiler_driver = args[i - 1];
   if (FindAnyPartial(compiler_driver, {"/", ".."}))
     compiler_driver = cleanup_maybe_relative_path(compiler_driver).path;
-  result.args.push_back(compiler_driver);
+  result_args.push_back(compiler_driver);
 
   // Add -working-directory if not provided.
   if (!clang_cl && !AnyStartsWith(args, "-working-directory"))
-    result.args.push_back("-working-directory=" + entry.directory);
+    result_args.push_back("-working-directory=" + entry.directory);
 
   if (!gTestOutputMode) {
     std::vector<const char*> platform = GetPlatformClangArguments();
     for (auto arg : platform)
-      result.args.push_back(arg);
+      result_args.push_back(arg);
   }
 
   bool next_flag_is_path = false;
   bool add_next_flag_to_quote_dirs = false;
   bool add_next_flag_to_angle_dirs = false;
+  // Collected locally and added to |config| once at the end, so concurrent
+  // calls do not contend on |config->mutex| for every path argument.
+  std::vector<Directory> quote_dirs;
+  std::vector<Directory> angle_dirs;
 
   // Note that when processing paths, some arguments support multiple forms, ie,
   // {"-Ifoo"} or {"-I", "foo"}.  Support both styles.
 
-  result.args.reserve(args.size() + config->extra_flags.size());
+  result_args.reserve(args.size() + config->extra_flags.size());
   for (; i < args.size(); ++i) {
     std::string arg = args[i];
 
@@ -384,9 +549,9 @@ Project::Entry GetCompilationEntryFromCompileCommandEntry(
     if (next_flag_is_path) {
       AbsolutePath normalized_arg = cleanup_maybe_relative_path(arg);
       if (add_next_flag_to_quote_dirs)
-        config->quote_dirs.insert(Directory(normalized_arg));
+        quote_dirs.push_back(Directory(normalized_arg));
       if (add_next_flag_to_angle_dirs)
-        config->angle_dirs.insert(Directory(normalized_arg));
+        angle_dirs.push_back(Directory(normalized_arg));
       if (clang_cl)
         arg = normalized_arg.path;
 
@@ -412,9 +577,9 @@ Project::Entry GetCompilationEntryFromCompileCommandEntry(
           if (clang_cl || StartsWithAny(arg, kNormalizePathArgs))
             arg = flag_type + path.path;
           if (ShouldAddToQuoteIncludes(flag_type))
-            config->quote_dirs.insert(Directory(path));
+            quote_dirs.push_back(Directory(path));
           if (ShouldAddToAngleIncludes(flag_type))
-            config->angle_dirs.insert(Directory(path));
+            angle_dirs.push_back(Directory(path));
           break;
         }
       }
@@ -432,38 +597,45 @@ Project::Entry GetCompilationEntryFromCompileCommandEntry(
         continue;
     }
 
-    result.args.push_back(arg);
+    result_args.push_back(arg);
   }
 
   // We don't do any special processing on user-given extra flags.
   for (const auto& flag : config->extra_flags)
-    result.args.push_back(flag);
+    result_args.push_back(flag);
 
   // Add -resource-dir so clang can correctly resolve system includes like
   // <cstddef>
-  if (!clang_cl && !AnyStartsWith(result.args, "-resource-dir") &&
+  if (!clang_cl && !AnyStartsWith(result_args, "-resource-dir") &&
       !config->resource_dir.empty()) {
-    result.args.push_back("-resource-dir=" + config->resource_dir);
+    result_args.push_back("-resource-dir=" + config->resource_dir);
   }
 
   // There could be a clang version mismatch between what the project uses and
   // what cquery uses. Make sure we do not emit warnings for mismatched
   // options.
-  if (!clang_cl && !AnyStartsWith(result.args, "-Wno-unknown-warning-option"))
-    result.args.push_back("-Wno-unknown-warning-option");
+  if (!clang_cl && !AnyStartsWith(result_args, "-Wno-unknown-warning-option"))
+    result_args.push_back("-Wno-unknown-warning-option");
 
   // Using -fparse-all-comments enables documentation in the indexer and in
   // code completion.
   if (!clang_cl && g_config->index.comments > 1 &&
-      !AnyStartsWith(result.args, "-fparse-all-comments")) {
-    result.args.push_back("-fparse-all-comments");
+      !AnyStartsWith(result_args, "-fparse-all-comments")) {
+    result_args.push_back("-fparse-all-comments");
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(config->mutex);
+    config->quote_dirs.insert(quote_dirs.begin(), quote_dirs.end());
+    config->angle_dirs.insert(angle_dirs.begin(), angle_dirs.end());
   }
 
   const auto& system_includes = GetSystemIncludes(config, compiler_driver, lang,
-                                                  entry.directory, result.args);
+                                                  entry.directory, result_args);
   for (const auto& flag : system_includes)
-    result.args.push_back(flag);
+    result_args.push_back(flag);
 
+  result.args = result_args;
   return result;
 }
 
@@ -479,10 +651,264 @@ std::vector<std::string> ReadCompilerArgumentsFromFile(
   return args;
 }
 
-std::vector<Project::Entry> LoadFromDirectoryListing(
+#if defined(_WIN32)
+constexpr bool kWindowsCommandLine = true;
+#else
+constexpr bool kWindowsCommandLine = false;
+#endif
+
+// Splits the "command" field of a compile_commands.json entry into arguments.
+// Like clang's JSONCompilationDatabase, this uses POSIX shell quoting rules,
+// or Windows command line quoting rules if |windows| is true.
+std::vector<std::string> SplitCommandLine(const std::string& command,
+                                          bool windows) {
+  std::vector<std::string> args;
+  std::string current;
+  bool in_arg = false;
+  char quote = 0;
+  for (size_t i = 0; i < command.size(); ++i) {
+    char c = command[i];
+    bool has_next = i + 1 < command.size();
+
+    if (quote) {
+      if (c == quote) {
+        quote = 0;
+      } else if (c == '\\' && quote == '"' && has_next &&
+                 (command[i + 1] == '"' ||
+                  (!windows && command[i + 1] == '\\'))) {
+        current += command[++i];
+      } else {
+        current += c;
+      }
+      continue;
+    }
+
+    if (isspace(static_cast<unsigned char>(c))) {
+      if (in_arg)
+        args.push_back(std::move(current));
+      current.clear();
+      in_arg = false;
+      continue;
+    }
+
+    in_arg = true;
+    if (c == '"' || (!windows && c == '\'')) {
+      quote = c;
+    } else if (c == '\\' && has_next &&
+               (!windows || command[i + 1] == '"')) {
+      current += command[++i];
+    } else {
+      current += c;
+    }
+  }
+  if (in_arg)
+    args.push_back(std::move(current));
+  return args;
+}
+
+// SAX handler for compile_commands.json. Entries are appended to |out| as soon
+// as they are complete, so the database is never held in memory as a DOM.
+struct CompileCommandsHandler
+    : rapidjson::BaseReaderHandler<rapidjson::UTF8<>, CompileCommandsHandler> {
+  enum class Field { kNone, kDirectory, kFile, kCommand, kArguments };
+
+  explicit CompileCommandsHandler(std::vector<CompileCommandsEntry>* out)
+      : out(out) {}
+
+  bool Default() {
+    if (depth == 2)
+      field = Field::kNone;
+    return true;
+  }
+
+  bool String(const char* str, rapidjson::SizeType length, bool) {
+    if (depth == 3 && field == Field::kArguments) {
+      current.args.emplace_back(str, length);
+      return true;
+    }
+    if (depth != 2)
+      return true;
+    switch (field) {
+      case Field::kDirectory:
+        current.directory.assign(str, length);
+        break;
+      case Field::kFile:
+        current.file.assign(str, length);
+        break;
+      case Field::kCommand:
+        current.command.assign(str, length);
+        break;
+      case Field::kNone:
+      case Field::kArguments:
+        break;
+    }
+    field = Field::kNone;
+    return true;
+  }
+
+  bool Key(const char* str, rapidjson::SizeType length, bool) {
+    if (depth != 2)
+      return true;
+    std::string_view key(str, length);
+    if (key == "directory")
+      field = Field::kDirectory;
+    else if (key == "file")
+      field = Field::kFile;
+    else if (key == "command")
+      field = Field::kCommand;
+    else if (key == "arguments")
+      field = Field::kArguments;
+    else
+      field = Field::kNone;
+    return true;
+  }
+
+  bool StartObject() {
+    // The database must be an array of objects.
+    if (depth == 0)
+      return false;
+    if (++depth == 2) {
+      current = CompileCommandsEntry();
+      has_arguments = false;
+    }
+    return true;
+  }
+
+  bool EndObject(rapidjson::SizeType) {
+    if (depth == 2)
+      FinishEntry();
+    --depth;
+    field = Field::kNone;
+    return true;
+  }
+
+  bool StartArray() {
+    if (depth == 2 && field == Field::kArguments)
+      has_arguments = true;
+    ++depth;
+    return true;
+  }
+
+  bool EndArray(rapidjson::SizeType) {
+    --depth;
+    field = Field::kNone;
+    return true;
+  }
+
+  void FinishEntry() {
+    if (current.file.empty()) {
+      LOG_S(WARNING) << "Skipping compile_commands.json entry without a file";
+      return;
+    }
+    // "arguments" takes precedence over "command".
+    if (!has_arguments)
+      current.args = SplitCommandLine(current.command, kWindowsCommandLine);
+    if (!IsAbsolutePath(current.file))
+      current.file = current.directory + "/" + current.file;
+    out->push_back(std::move(current));
+  }
+
+  std::vector<CompileCommandsEntry>* out;
+  CompileCommandsEntry current;
+  bool has_arguments = false;
+  Field field = Field::kNone;
+  int depth = 0;
+};
+
+template <typename Stream>
+optional<std::vector<CompileCommandsEntry>> ParseCompileCommands(
+    Stream& stream) {
+  std::vector<CompileCommandsEntry> result;
+  CompileCommandsHandler handler(&result);
+  rapidjson::Reader reader;
+  rapidjson::ParseResult ok = reader.Parse(stream, handler);
+  if (!ok) {
+    LOG_S(WARNING) << "Failed to parse compile_commands.json: "
+                   << rapidjson::GetParseError_En(ok.Code()) << " ("
+                   << ok.Offset() << ")";
+    return nullopt;
+  }
+  return result;
+}
+
+optional<std::vector<CompileCommandsEntry>> ReadCompileCommandsFromFile(
+    const std::string& path) {
+  FILE* file = fopen(path.c_str(), "rb");
+  if (!file)
+    return nullopt;
+  char buffer[1 << 16];
+  rapidjson::FileReadStream stream(file, buffer, sizeof(buffer));
+  optional<std::vector<CompileCommandsEntry>> result =
+      ParseCompileCommands(stream);
+  fclose(file);
+  return result;
+}
+
+// Runs GetCompilationEntryFromCompileCommandEntry over |commands| on multiple
+// threads, since path normalization and system include discovery dominate
+// project load time for large compilation databases.
+//
+// |on_entry| (if set) is called on the calling thread, in order, as soon as
+// each chunk of entries has been processed, so callers can dispatch work
+// before the whole project is loaded.
+std::vector<Project::Entry> ProcessCompileCommandsEntries(
+    ProjectConfig* config,
+    const std::vector<CompileCommandsEntry>& commands,
+    const std::function<void(int i, const Project::Entry& entry)>& on_entry) {
+  const size_t kChunkSize = 64;
+  const size_t num_chunks = (commands.size() + kChunkSize - 1) / kChunkSize;
+  auto chunk_end = [&](size_t chunk) {
+    return std::min(commands.size(), (chunk + 1) * kChunkSize);
+  };
+
+  std::vector<Project::Entry> result(commands.size());
+  std::mutex mutex;
+  std::condition_variable cv;
+  std::vector<char> chunk_done(num_chunks, false);
+  std::atomic<size_t> next_chunk(0);
+
+  auto worker = [&]() {
+    SetCurrentThreadName("project");
+    while (true) {
+      size_t chunk = next_chunk++;
+      if (chunk >= num_chunks)
+        return;
+      for (size_t i = chunk * kChunkSize; i < chunk_end(chunk); ++i)
+        result[i] = GetCompilationEntryFromCompileCommandEntry(config,
+                                                               commands[i]);
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+        chunk_done[chunk] = true;
+      }
+      cv.notify_all();
+    }
+  };
+
+  size_t num_threads = std::min<size_t>(
+      num_chunks, std::max(1u, std::thread::hardware_concurrency()));
+  std::vector<std::thread> threads;
+  for (size_t i = 0; i < num_threads; ++i)
+    threads.emplace_back(worker);
+
+  for (size_t chunk = 0; chunk < num_chunks; ++chunk) {
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      cv.wait(lock, [&]() { return chunk_done[chunk]; });
+    }
+    if (!on_entry)
+      continue;
+    for (size_t i = chunk * kChunkSize; i < chunk_end(chunk); ++i)
+      on_entry(int(i), result[i]);
+  }
+
+  for (std::thread& thread : threads)
+    thread.join();
+  return result;
+}
+
+std::vector<CompileCommandsEntry> LoadFromDirectoryListing(
     ProjectConfig* config,
     bool use_global_config = false) {
-  std::vector<Project::Entry> result;
   config->mode = ProjectMode::DotCquery;
 
   std::unordered_map<std::string, std::vector<std::string>> folder_args;
@@ -502,17 +928,21 @@ std::vector<Project::Entry> LoadFromDirectoryListing(
     }
   }
 
-  GetFilesAndDirectoriesInFolder(
-      config->project_dir, true /*recursive*/, true /*add_folder_to_path*/,
-      [&folder_args, &files](const std::string& path) {
-        if (SourceFileLanguage(path) != LanguageId::Unknown) {
-          files.push_back(path);
-        } else if (GetBaseName(path) == ".cquery"  && !IsDirectory(GetDirName(path) + ".cquery")) {
-          LOG_S(INFO) << "Using .cquery arguments from " << path;
-          folder_args.emplace(GetDirName(path),
-                              ReadCompilerArgumentsFromFile(path));
-        }
+  std::vector<std::string> listing = GetFilesInFolderParallel(
+      config->project_dir, true /*add_folder_to_path*/, {},
+      [](const std::string& path) {
+        return SourceFileLanguage(path) != LanguageId::Unknown ||
+               GetBaseName(path) == ".cquery";
       });
+  for (std::string& path : listing) {
+    if (GetBaseName(path) != ".cquery") {
+      files.push_back(std::move(path));
+    } else if (!IsDirectory(path)) {
+      LOG_S(INFO) << "Using .cquery arguments from " << path;
+      folder_args.emplace(GetDirName(path),
+                          ReadCompilerArgumentsFromFile(path));
+    }
+  }
 
   if (use_global_config) {
     optional<std::string> maybe_cfg = GetGlobalConfigDirectory();
@@ -559,6 +989,8 @@ std::vector<Project::Entry> LoadFromDirectoryListing(
         return project_dir_args;
       };
 
+  std::vector<CompileCommandsEntry> commands;
+  commands.reserve(files.size());
   for (const std::string& file : files) {
     CompileCommandsEntry e;
     e.directory = config->project_dir;
@@ -567,13 +999,12 @@ std::vector<Project::Entry> LoadFromDirectoryListing(
     if (e.args.empty())
       e.args.push_back("%clang");  // Add a Dummy.
     e.args.push_back(e.file);
-    result.push_back(GetCompilationEntryFromCompileCommandEntry(config, e));
+    commands.push_back(std::move(e));
   }
-
-  return result;
+  return commands;
 }
 
-std::vector<Project::Entry> LoadCompilationEntriesFromDirectory(
+std::vector<CompileCommandsEntry> LoadCompileCommandsFromDirectory(
     ProjectConfig* project,
     const std::string& opt_compilation_db_dir) {
   // If there is a .cquery file always load using directory listing.
@@ -583,26 +1014,31 @@ std::vector<Project::Entry> LoadCompilationEntriesFromDirectory(
     return LoadFromDirectoryListing(project);
   }
 
-  // If |compilationDatabaseCommand| is specified, execute it to get the compdb.
+  Timer timer;
+  optional<std::vector<CompileCommandsEntry>> commands;
   std::string comp_db_dir(opt_compilation_db_dir);
   if (g_config->compilationDatabaseCommand.empty()) {
     project->mode = ProjectMode::CompileCommandsJson;
     // Try to load compile_commands.json, but fallback to a project listing.
-  } else {
-    project->mode = ProjectMode::ExternalCommand;
-
-    // generally it would be nice if we could just let clang load the
-    // compilation database (compile_commands.json) from memory.
-    // However, clang insists on reading compile_commands.json from a
-    // directory, so we create a temporary directory just for clang to read
-    // from.
+    if (!IsAbsolutePath(comp_db_dir)) {
+      comp_db_dir =
+          project->normalization_cache.Get(project->project_dir + comp_db_dir);
+    }
+    EnsureEndsInSlash(comp_db_dir);
 
-    auto tmpdir = TryMakeTempDirectory();
-    if(!tmpdir.has_value()) {
-        return {};
+    std::string comp_db_path = comp_db_dir + "compile_commands.json";
+    LOG_S(INFO) << "Trying to load " << comp_db_path;
+    if (!FileExists(comp_db_path)) {
+      comp_db_path = project->project_dir + "compile_commands.json";
+      LOG_S(INFO) << "Trying to load " << comp_db_path;
     }
-    comp_db_dir = tmpdir.value();
+    if (FileExists(comp_db_path))
+      commands = ReadCompileCommandsFromFile(comp_db_path);
+  } else {
+    project->mode = ProjectMode::ExternalCommand;
 
+    // The external command writes the JSON compilation database to stdout,
+    // which is parsed directly.
     rapidjson::StringBuffer input;
     rapidjson::Writer<rapidjson::StringBuffer> writer(input);
     JsonWriter json_writer(&writer);
@@ -611,111 +1047,112 @@ std::vector<Project::Entry> LoadCompilationEntriesFromDirectory(
         std::vector<std::string>{g_config->compilationDatabaseCommand,
                                  project->project_dir},
         input.GetString());
-    std::ofstream(comp_db_dir + "/compile_commands.json")
-        << contents.value_or("");
-
-  }
-
-  CXCompilationDatabase_Error cx_db_load_error =
-      CXCompilationDatabase_CanNotLoadDatabase;
-  CXCompilationDatabase cx_db = nullptr;
-
-  if (!IsAbsolutePath(comp_db_dir)) {
-    comp_db_dir =
-        project->normalization_cache.Get(project->project_dir + comp_db_dir);
-  }
-
-  EnsureEndsInSlash(comp_db_dir);
-
-  LOG_S(INFO) << "Trying to load " << comp_db_dir << "compile_commands.json";
-  // Do not call clang_CompilationDatabase_fromDirectory if
-  // compile_commands.json does not exist; it will report an error on stderr.
-  if (FileExists(comp_db_dir + "compile_commands.json")) {
-    cx_db = clang_CompilationDatabase_fromDirectory(comp_db_dir.c_str(),
-                                                    &cx_db_load_error);
-  } else {
-    LOG_S(INFO) << "Trying to load " << project->project_dir
-                << "compile_commands.json";
-    if (FileExists(project->project_dir + "compile_commands.json")) {
-      cx_db = clang_CompilationDatabase_fromDirectory(
-          project->project_dir.c_str(), &cx_db_load_error);
+    if (contents) {
+      rapidjson::StringStream stream(contents->c_str());
+      commands = ParseCompileCommands(stream);
     }
   }
 
-  if (!g_config->compilationDatabaseCommand.empty()) {
-    RemoveDirectoryRecursive(comp_db_dir);
-  }
-
-  if (cx_db_load_error != CXCompilationDatabase_NoError) {
+  if (!commands) {
     LOG_S(INFO) << "Unable to load compile_commands.json located at \""
                 << comp_db_dir << "\"; using directory listing instead.";
     return LoadFromDirectoryListing(project, true);
   }
+  timer.ResetAndPrint("[perf] Parsed compile_commands.json (" +
+                      std::to_string(commands->size()) + " entries)");
+  return std::move(*commands);
+}
 
-  Timer clang_time;
-  Timer our_time;
-  clang_time.Pause();
-  our_time.Pause();
-
-  clang_time.Resume();
-  CXCompileCommands cx_commands =
-      clang_CompilationDatabase_getAllCompileCommands(cx_db);
-  unsigned int num_commands = clang_CompileCommands_getSize(cx_commands);
-  clang_time.Pause();
-
-  std::vector<Project::Entry> result;
-  for (unsigned int i = 0; i < num_commands; i++) {
-    clang_time.Resume();
-    CXCompileCommand cx_command =
-        clang_CompileCommands_getCommand(cx_commands, i);
-
-    std::string directory =
-        ToString(clang_CompileCommand_getDirectory(cx_command));
-    std::string relative_filename =
-        ToString(clang_CompileCommand_getFilename(cx_command));
+// Bump this whenever the cache layout or the way compilation entries are
+// computed from compile commands changes.
+const int kProjectCacheVersion = 1;
+
+// The fully processed project, which is written to the cache directory so that
+// warm starts do not need to run compiler drivers or normalize paths again.
+struct ProjectCache {
+  // Hash of everything the entries were computed from, see HashProjectInputs.
+  uint64_t inputs_hash = 0;
+  // System include discovery depends on the compiler drivers, so the cache is
+  // only valid as long as none of them has been changed.
+  std::vector<CompilerDriverStamp> compiler_drivers;
+  std::vector<Project::Entry> entries;
+  std::vector<std::string> quote_dirs;
+  std::vector<std::string> angle_dirs;
+};
+MAKE_REFLECT_STRUCT(ProjectCache,
+                    inputs_hash,
+                    compiler_drivers,
+                    entries,
+                    quote_dirs,
+                    angle_dirs);
+
+void HashCombineStable(uint64_t& seed, std::string_view value) {
+  seed ^= HashUsr(value) + 0x9e3779b97f4a7c15ull + (seed << 6) + (seed >> 2);
+}
 
-    unsigned num_args = clang_CompileCommand_getNumArgs(cx_command);
-    CompileCommandsEntry entry;
-    entry.args.reserve(num_args);
-    for (unsigned j = 0; j < num_args; ++j) {
-      entry.args.push_back(
-          ToString(clang_CompileCommand_getArg(cx_command, j)));
-    }
-    clang_time.Pause();  // TODO: don't call ToString in this block.
-    // LOG_S(INFO) << "Got args " << StringJoin(entry.args);
+// Hashes the contents of compile_commands.json (or the .cquery files and the
+// directory listing) together with the configuration which affects how the
+// entries are processed.
+uint64_t HashProjectInputs(const ProjectConfig& config,
+                           const std::vector<CompileCommandsEntry>& commands) {
+  uint64_t hash = 0;
+  HashCombineStable(hash, std::to_string(kProjectCacheVersion));
+  HashCombineStable(hash, std::to_string(static_cast<int>(config.mode)));
+  HashCombineStable(hash, config.project_dir);
+  HashCombineStable(hash, config.resource_dir);
+  // Configuration read while processing entries.
+  HashCombineStable(hash, g_config->discoverSystemIncludes ? "1" : "0");
+  HashCombineStable(hash, std::to_string(g_config->index.comments));
+  HashCombineStable(hash, std::to_string(config.extra_flags.size()));
+  for (const std::string& flag : config.extra_flags)
+    HashCombineStable(hash, flag);
+  for (const CompileCommandsEntry& command : commands) {
+    HashCombineStable(hash, command.directory);
+    HashCombineStable(hash, command.file);
+    HashCombineStable(hash, std::to_string(command.args.size()));
+    for (const std::string& arg : command.args)
+      HashCombineStable(hash, arg);
+  }
+  return hash;
+}
 
-    our_time.Resume();
-    entry.directory = directory;
-    std::string absolute_filename;
-    if (IsAbsolutePath(relative_filename)) {
-      absolute_filename = relative_filename;
-    } else {
-      absolute_filename = directory + "/" + relative_filename;
-    }
-    entry.file = project->normalization_cache.Get(absolute_filename);
+std::string GetProjectCachePath(const std::string& project_dir) {
+  return g_config->cacheDirectory + EscapeFileName(project_dir) +
+         ".project.mpack";
+}
 
-    result.push_back(
-        GetCompilationEntryFromCompileCommandEntry(project, entry));
-    our_time.Pause();
+optional<ProjectCache> LoadProjectCache(const std::string& project_dir,
+                                        uint64_t inputs_hash) {
+  optional<ProjectCache> cache = ReadCacheFile<ProjectCache>(
+      GetProjectCachePath(project_dir), kProjectCacheVersion);
+  if (!cache || cache->inputs_hash != inputs_hash)
+    return nullopt;
+  if (!CompilerDriversUnchanged(cache->compiler_drivers)) {
+    LOG_S(INFO) << "Compiler drivers changed; ignoring project cache";
+    return nullopt;
   }
+  return cache;
+}
 
-  clang_time.Resume();
-  clang_CompileCommands_dispose(cx_commands);
-  clang_CompilationDatabase_dispose(cx_db);
-  clang_time.Pause();
+void WriteProjectCache(ProjectConfig* config, ProjectCache& cache) {
+  for (const std::string& driver : config->compiler_drivers)
+    cache.compiler_drivers.push_back(GetCompilerDriverStamp(driver));
+  for (const Directory& dir : config->quote_dirs)
+    cache.quote_dirs.push_back(dir.path);
+  for (const Directory& dir : config->angle_dirs)
+    cache.angle_dirs.push_back(dir.path);
 
-  clang_time.ResetAndPrint("compile_commands.json clang time");
-  our_time.ResetAndPrint("compile_commands.json our time");
-  return result;
+  WriteCacheFile(GetProjectCachePath(config->project_dir),
+                 kProjectCacheVersion, cache);
 }
 
+const int kMatchPrefixWeight = 100;
+const int kMismatchDirectoryWeight = 100;
+const int kMatchPostfixWeight = 1;
+
 // Computes a score based on how well |a| and |b| match. This is used for
 // argument guessing.
 int ComputeGuessScore(const std::string& a, const std::string& b) {
-  const int kMatchPrefixWeight = 100;
-  const int kMismatchDirectoryWeight = 100;
-  const int kMatchPostfixWeight = 1;
-
   int score = 0;
   size_t i = 0;
 
@@ -747,19 +1184,213 @@ int ComputeGuessScore(const std::string& a, const std::string& b) {
   return score;
 }
 
+Project::InferenceIndex BuildInferenceIndex(
+    const std::vector<Project::Entry>& entries) {
+  Project::InferenceIndex index;
+  index.sorted.resize(entries.size());
+  for (int i = 0; i < (int)entries.size(); ++i)
+    index.sorted[i] = i;
+  std::sort(index.sorted.begin(), index.sorted.end(), [&](int a, int b) {
+    return entries[a].filename.path < entries[b].filename.path;
+  });
+
+  size_t n = index.sorted.size();
+  index.min_slashes_before.assign(n + 1, std::numeric_limits<int>::max());
+  index.min_slashes_from.assign(n + 1, std::numeric_limits<int>::max());
+  for (size_t i = 0; i < n; ++i) {
+    const std::string& path = entries[index.sorted[i]].filename.path;
+    index.min_slashes_before[i + 1] =
+        std::min(index.min_slashes_before[i],
+                 int(std::count(path.begin(), path.end(), '/')));
+  }
+  for (size_t i = n; i-- > 0;) {
+    const std::string& path = entries[index.sorted[i]].filename.path;
+    index.min_slashes_from[i] =
+        std::min(index.min_slashes_from[i + 1],
+                 int(std::count(path.begin(), path.end(), '/')));
+  }
+  return index;
+}
+
+// Returns the index of the entry that ComputeGuessScore rates highest for
+// |filename|, or -1 if there are no entries.
+//
+// Entries sharing a longer prefix with |filename| are adjacent to its
+// insertion point in |index.sorted|, so they are visited from there outwards
+// in order of decreasing common prefix length. The walk stops as soon as no
+// remaining entry can beat the best score, which usually leaves only the
+// entries of the closest directory to be scored. The result is identical to
+// scoring every entry, including picking the lowest index on ties.
+int FindBestEntryIndex(const std::vector<Project::Entry>& entries,
+                       const Project::InferenceIndex& index,
+                       const std::string& filename) {
+  const std::vector<int>& sorted = index.sorted;
+  // slashes_before[i] and slashes_after[i] are the number of '/' in
+  // filename[:i] and filename[i:].
+  std::vector<int> slashes_before(filename.size() + 1, 0);
+  std::vector<int> slashes_after(filename.size() + 1, 0);
+  for (size_t i = 0; i < filename.size(); ++i)
+    slashes_before[i + 1] = slashes_before[i] + (filename[i] == '/');
+  for (size_t i = filename.size(); i-- > 0;)
+    slashes_after[i] = slashes_after[i + 1] + (filename[i] == '/');
+
+  auto common_prefix = [&](int entry) {
+    const std::string& path = entries[entry].filename.path;
+    size_t n = 0;
+    while (n < path.size() && n < filename.size() && path[n] == filename[n])
+      ++n;
+    return n;
+  };
+  // Upper bound for the score of an entry which shares at most |prefix|
+  // characters with |filename| and has at least |min_slashes| '/' in total:
+  // it has as few directories after the prefix as possible and the common
+  // ending is as long as possible.
+  auto max_score = [&](size_t prefix, int min_slashes) {
+    if (min_slashes == std::numeric_limits<int>::max())
+      return std::numeric_limits<int>::min();
+    int min_slashes_after =
+        std::max(0, min_slashes - slashes_before[prefix]);
+    return kMatchPrefixWeight * int(prefix) -
+           kMismatchDirectoryWeight *
+               (slashes_after[prefix] + min_slashes_after) +
+           kMatchPostfixWeight * int(filename.size());
+  };
+
+  size_t hi = std::lower_bound(sorted.begin(), sorted.end(), filename,
+                               [&](int entry, const std::string& value) {
+                                 return entries[entry].filename.path < value;
+                               }) -
+              sorted.begin();
+  size_t lo = hi;
+  size_t lo_prefix = lo > 0 ? common_prefix(sorted[lo - 1]) : 0;
+  size_t hi_prefix = hi < sorted.size() ? common_prefix(sorted[hi]) : 0;
+
+  int best = -1;
+  int best_score = std::numeric_limits<int>::min();
+  while (lo > 0 || hi < sorted.size()) {
+    if (best != -1 &&
+        best_score > max_score(lo_prefix, index.min_slashes_before[lo]) &&
+        best_score > max_score(hi_prefix, index.min_slashes_from[hi]))
+      break;
+
+    bool take_lo = lo > 0 && (hi == sorted.size() || lo_prefix >= hi_prefix);
+
+    int entry;
+    if (take_lo) {
+      entry = sorted[--lo];
+      lo_prefix = lo > 0 ? common_prefix(sorted[lo - 1]) : 0;
+    } else {
+      entry = sorted[hi++];
+      hi_prefix = hi < sorted.size() ? common_prefix(sorted[hi]) : 0;
+    }
+
+    int score = ComputeGuessScore(filename, entries[entry].filename);
+    if (score > best_score || (score == best_score && entry < best)) {
+      best = entry;
+      best_score = score;
+    }
+  }
+  return best;
+}
+
+void EnqueueIndexRequest(QueueManager* queue,
+                         WorkingFiles* working_files,
+                         lsRequestId id,
+                         const Project::Entry& entry) {
+  bool is_interactive =
+      working_files->GetFileByFilename(entry.filename) != nullptr;
+  queue->index_request.Enqueue(
+      Index_Request(entry.filename, entry.args, is_interactive, nullopt,
+                    ICacheManager::Make(), id),
+      false /*priority*/);
+}
+
+std::string GetSystemIncludesCachePath() {
+  return g_config->cacheDirectory + "system_includes.mpack";
+}
+
+void LoadSystemIncludesCache(ProjectConfig* config) {
+  optional<std::vector<SystemIncludesCacheEntry>> cache =
+      ReadCacheFile<std::vector<SystemIncludesCacheEntry>>(
+          GetSystemIncludesCachePath(), kSystemIncludesCacheVersion);
+  if (!cache)
+    return;
+  for (SystemIncludesCacheEntry& entry : *cache) {
+    std::string key = entry.key;
+    config->system_includes_cache[key] = std::move(entry);
+  }
+}
+
+// Other projects may have added toolchains since this one read the file, so
+// merge them back in before writing.
+void WriteSystemIncludesCache(ProjectConfig* config) {
+  if (!config->system_includes_cache_dirty)
+    return;
+  optional<std::vector<SystemIncludesCacheEntry>> cache =
+      ReadCacheFile<std::vector<SystemIncludesCacheEntry>>(
+          GetSystemIncludesCachePath(), kSystemIncludesCacheVersion);
+  std::vector<SystemIncludesCacheEntry> merged;
+  if (cache) {
+    for (SystemIncludesCacheEntry& entry : *cache) {
+      if (!config->system_includes_cache.count(entry.key))
+        merged.push_back(std::move(entry));
+    }
+  }
+  for (auto& it : config->system_includes_cache)
+    merged.push_back(it.second);
+  WriteCacheFile(GetSystemIncludesCachePath(), kSystemIncludesCacheVersion,
+                 merged);
+}
+
 }  // namespace
 
-void Project::Load(const AbsolutePath& root_directory) {
+void Project::Load(
+    const AbsolutePath& root_directory,
+    std::function<void(int i, const Entry& entry)> on_entry) {
   // Load data.
   ProjectConfig project;
   project.extra_flags = g_config->extraClangArguments;
   project.project_dir = root_directory;
   project.resource_dir = g_config->resourceDirectory;
-  entries = LoadCompilationEntriesFromDirectory(
+  std::vector<CompileCommandsEntry> commands = LoadCompileCommandsFromDirectory(
       &project, g_config->compilationDatabaseDirectory.empty()
                     ? "build"
                     : g_config->compilationDatabaseDirectory);
 
+  // Reuse the processed entries from the previous run if none of the inputs
+  // changed. Nothing is cached if there is no cache directory, ie, in tests.
+  bool use_cache = !g_config->cacheDirectory.empty();
+  uint64_t inputs_hash = use_cache ? HashProjectInputs(project, commands) : 0;
+  optional<ProjectCache> cache;
+  if (use_cache)
+    cache = LoadProjectCache(project.project_dir, inputs_hash);
+
+  Timer timer;
+  if (cache) {
+    entries = std::move(cache->entries);
+    for (const std::string& dir : cache->quote_dirs)
+      project.quote_dirs.insert(Directory(AbsolutePath(dir, false)));
+    for (const std::string& dir : cache->angle_dirs)
+      project.angle_dirs.insert(Directory(AbsolutePath(dir, false)));
+    if (on_entry) {
+      for (int i = 0; i < (int)entries.size(); ++i)
+        on_entry(i, entries[i]);
+    }
+    timer.ResetAndPrint("[perf] Loaded compilation entries from project cache");
+  } else {
+    if (use_cache)
+      LoadSystemIncludesCache(&project);
+    entries = ProcessCompileCommandsEntries(&project, commands, on_entry);
+    timer.ResetAndPrint("[perf] Processed compilation entries");
+    if (use_cache) {
+      WriteSystemIncludesCache(&project);
+      ProjectCache new_cache;
+      new_cache.inputs_hash = inputs_hash;
+      new_cache.entries = entries;
+      WriteProjectCache(&project, new_cache);
+    }
+  }
+
   // Cleanup / postprocess include directories.
   quote_include_directories.assign(project.quote_dirs.begin(),
                                    project.quote_dirs.end());
@@ -773,6 +1404,11 @@ void Project::Load(const AbsolutePath& root_directory) {
   }
 
   // Setup project entries.
+  {
+    std::lock_guard<std::mutex> lock(inference_mutex_);
+    inference_index_ = InferenceIndex();
+    inferred_entry_index_.clear();
+  }
   absolute_path_to_entry_index_.resize(entries.size());
   for (int i = 0; i < entries.size(); ++i)
     absolute_path_to_entry_index_[entries[i].filename] = i;
@@ -801,35 +1437,43 @@ Project::Entry Project::FindCompilationEntryForFile(
     return entries[it->second];
 
   // We couldn't find the file. Try to infer it.
-  // TODO: Cache inferred file in a separate array (using a lock or similar)
-  Entry* best_entry = nullptr;
-  int best_score = std::numeric_limits<int>::min();
-  for (Entry& entry : entries) {
-    int score = ComputeGuessScore(filename, entry.filename);
-    if (score > best_score) {
-      best_score = score;
-      best_entry = &entry;
+  int best_index;
+  {
+    std::lock_guard<std::mutex> lock(inference_mutex_);
+    if (inference_index_.sorted.size() != entries.size()) {
+      inference_index_ = BuildInferenceIndex(entries);
+      inferred_entry_index_.clear();
+    }
+
+    auto cached = inferred_entry_index_.find(filename);
+    if (cached != inferred_entry_index_.end()) {
+      best_index = cached->second;
+    } else {
+      best_index =
+          FindBestEntryIndex(entries, inference_index_, filename.path);
+      inferred_entry_index_[filename] = best_index;
     }
   }
+  const Entry* best_entry = best_index >= 0 ? &entries[best_index] : nullptr;
 
   Project::Entry result;
   result.is_inferred = true;
   result.filename = filename;
   if (!best_entry) {
-    result.args.push_back("%clang");
-    result.args.push_back(filename);
+    result.args = {"%clang", filename};
   } else {
-    result.args = best_entry->args;
+    std::vector<std::string> args = best_entry->args.ToVector();
 
     // |best_entry| probably has its own path in the arguments. We need to remap
     // that path to the new filename.
     std::string best_entry_base_name = GetBaseName(best_entry->filename);
-    for (std::string& arg : result.args) {
+    for (std::string& arg : args) {
       if (arg == best_entry->filename.path ||
           GetBaseName(arg) == best_entry_base_name) {
         arg = filename;
       }
     }
+    result.args = args;
   }
 
   return result;
@@ -856,12 +1500,23 @@ void Project::Index(QueueManager* queue,
                     WorkingFiles* working_files,
                     lsRequestId id) {
   ForAllFilteredFiles([&](int i, const Project::Entry& entry) {
-    bool is_interactive =
-        working_files->GetFileByFilename(entry.filename) != nullptr;
-    queue->index_request.Enqueue(
-        Index_Request(entry.filename, entry.args, is_interactive, nullopt,
-                      ICacheManager::Make(), id),
-        false /*priority*/);
+    EnqueueIndexRequest(queue, working_files, id, entry);
+  });
+}
+
+void Project::LoadAndIndex(const AbsolutePath& root_directory,
+                           QueueManager* queue,
+                           WorkingFiles* working_files,
+                           lsRequestId id) {
+  GroupMatch matcher(g_config->index.whitelist, g_config->index.blacklist);
+  Load(root_directory, [&](int i, const Project::Entry& entry) {
+    std::string failure_reason;
+    if (matcher.IsMatch(entry.filename, &failure_reason)) {
+      EnqueueIndexRequest(queue, working_files, id, entry);
+    } else if (g_config->index.logSkippedPaths) {
+      LOG_S(INFO) << "[" << i + 1 << "]: Failed " << failure_reason
+                  << "; skipping " << entry.filename;
+    }
   });
 }
 
@@ -1692,6 +2347,121 @@ TEST_SUITE("Project") {
     REQUIRE(config.quote_dirs == quote_expected);
   }
 
+  TEST_CASE("Split command line") {
+    REQUIRE(SplitCommandLine("clang++ -DA=\"a b\" 'c d' e\\ f  -c", false) ==
+            std::vector<std::string>{"clang++", "-DA=a b", "c d", "e f", "-c"});
+    REQUIRE(SplitCommandLine("cl.exe /I\"C:\\a b\" C:\\foo.cc", true) ==
+            std::vector<std::string>{"cl.exe", "/IC:\\a b", "C:\\foo.cc"});
+  }
+
+  TEST_CASE("compile_commands.json parsing") {
+    std::string json = R"([
+      {"directory": "/dir", "file": "a.cc", "command": "clang++ -c a.cc",
+       "output": {"ignored": [1, 2]}},
+      {"directory": "/dir", "file": "/abs/b.cc", "command": "ignored",
+       "arguments": ["clang", "-DX", "b.cc"]}
+    ])";
+    rapidjson::StringStream stream(json.c_str());
+    optional<std::vector<CompileCommandsEntry>> commands =
+        ParseCompileCommands(stream);
+    REQUIRE(commands);
+    REQUIRE(commands->size() == 2);
+    REQUIRE((*commands)[0].file == "/dir/a.cc");
+    REQUIRE((*commands)[0].args ==
+            std::vector<std::string>{"clang++", "-c", "a.cc"});
+    REQUIRE((*commands)[1].file == "/abs/b.cc");
+    REQUIRE((*commands)[1].args ==
+            std::vector<std::string>{"clang", "-DX", "b.cc"});
+
+    rapidjson::StringStream not_an_array("{\"file\": \"a.cc\"}");
+    REQUIRE(!ParseCompileCommands(not_an_array));
+  }
+
+  TEST_CASE("Project cache inputs hash") {
+    ProjectConfig config;
+    config.project_dir = "/project/";
+    std::vector<CompileCommandsEntry> commands(2);
+    commands[0].directory = "/project";
+    commands[0].file = "/project/a.cc";
+    commands[0].args = {"clang++", "-DA", "a.cc"};
+    commands[1] = commands[0];
+    commands[1].file = "/project/b.cc";
+    uint64_t hash = HashProjectInputs(config, commands);
+    REQUIRE(HashProjectInputs(config, commands) == hash);
+
+    // Moving an argument between entries must change the hash.
+    commands[0].args.pop_back();
+    commands[1].args.push_back("a.cc");
+    REQUIRE(HashProjectInputs(config, commands) != hash);
+    commands[1].args.pop_back();
+    commands[0].args.push_back("a.cc");
+    REQUIRE(HashProjectInputs(config, commands) == hash);
+
+    config.extra_flags.push_back("-DB");
+    REQUIRE(HashProjectInputs(config, commands) != hash);
+  }
+
+  TEST_CASE("Project cache is invalidated by config changes") {
+    optional<AbsolutePath> root = TryMakeTempDirectory();
+    REQUIRE(root);
+    std::string cache_directory = g_config->cacheDirectory;
+    int comments = g_config->index.comments;
+    g_config->cacheDirectory = root->path;
+    EnsureEndsInSlash(g_config->cacheDirectory);
+
+    ProjectConfig config;
+    config.project_dir = "/project/";
+    std::vector<CompileCommandsEntry> commands(1);
+    commands[0].directory = "/project";
+    commands[0].file = "/project/a.cc";
+    commands[0].args = {"clang++", "a.cc"};
+
+    g_config->index.comments = 2;
+    ProjectCache cache;
+    cache.inputs_hash = HashProjectInputs(config, commands);
+    WriteProjectCache(&config, cache);
+    REQUIRE(LoadProjectCache(config.project_dir,
+                             HashProjectInputs(config, commands)));
+
+    // Entries written with -fparse-all-comments must not be reused.
+    g_config->index.comments = 1;
+    REQUIRE(!LoadProjectCache(config.project_dir,
+                              HashProjectInputs(config, commands)));
+
+    g_config->cacheDirectory = cache_directory;
+    g_config->index.comments = comments;
+    RemoveDirectoryRecursive(*root);
+  }
+
+  TEST_CASE("Parallel entry processing preserves order") {
+    g_disable_normalize_path_for_test = true;
+    gTestOutputMode = true;
+
+    ProjectConfig config;
+    config.project_dir = "/w/c/s/";
+
+    std::vector<CompileCommandsEntry> commands;
+    for (int i = 0; i < 1000; ++i) {
+      CompileCommandsEntry entry;
+      entry.directory = "/dir";
+      entry.file = "/dir/" + std::to_string(i) + ".cc";
+      entry.args = {"clang", "-I" + std::to_string(i), entry.file};
+      commands.push_back(entry);
+    }
+
+    std::vector<int> seen;
+    std::vector<Project::Entry> result = ProcessCompileCommandsEntries(
+        &config, commands, [&](int i, const Project::Entry& entry) {
+          REQUIRE(entry.filename.path == "&" + commands[i].file);
+          seen.push_back(i);
+        });
+    REQUIRE(result.size() == commands.size());
+    REQUIRE(seen.size() == commands.size());
+    for (int i = 0; i < (int)seen.size(); ++i)
+      REQUIRE(seen[i] == i);
+    REQUIRE(config.angle_dirs.size() == commands.size());
+  }
+
   TEST_CASE("Entry inference") {
     Project p;
     {
@@ -1804,4 +2574,56 @@ TEST_SUITE("Project") {
       REQUIRE(entry->args == std::vector<std::string>{"arg3"});
     }
   }
+
+  // Also serves as a microbenchmark; the timings are printed to the log.
+  TEST_CASE("Entry inference in a large project") {
+    Project p;
+    for (int i = 0; i < 100000; ++i) {
+      Project::Entry e;
+      e.filename = AbsolutePath("/src/module" + std::to_string(i % 500) +
+                                "/sub" + std::to_string(i % 7) + "/file" +
+                                std::to_string(i) + ".cc");
+      e.args = {"clang++", "-DENTRY=" + std::to_string(i), e.filename};
+      p.entries.push_back(e);
+    }
+
+    std::vector<AbsolutePath> queries;
+    for (int i = 0; i < 1000; ++i) {
+      std::string module = "/src/module" + std::to_string(i * 7 % 600);
+      if (i % 3 == 0)
+        queries.push_back(AbsolutePath(module + "/file" + std::to_string(i) +
+                                       ".h"));
+      else if (i % 3 == 1)
+        queries.push_back(AbsolutePath(module + "/sub" +
+                                       std::to_string(i % 9) + "/file" +
+                                       std::to_string(i * 100) + ".h"));
+      else
+        queries.push_back(AbsolutePath(module + "/new/dir/x.cc"));
+    }
+
+    Timer timer;
+    std::vector<std::string> indexed;
+    for (const AbsolutePath& query : queries)
+      indexed.push_back(p.FindCompilationEntryForFile(query).args[1]);
+    timer.ResetAndPrint("[perf] Inferred 1000 entries from 100000");
+
+    for (const AbsolutePath& query : queries)
+      p.FindCompilationEntryForFile(query);
+    timer.ResetAndPrint("[perf] Inferred 1000 cached entries");
+
+    // Compare a sample against scoring every entry.
+    for (int i = 0; i < (int)queries.size(); i += 50) {
+      int best = -1;
+      int best_score = std::numeric_limits<int>::min();
+      for (int j = 0; j < (int)p.entries.size(); ++j) {
+        int score = ComputeGuessScore(queries[i], p.entries[j].filename);
+        if (score > best_score) {
+          best = j;
+          best_score = score;
+        }
+      }
+      REQUIRE(indexed[i] == "-DENTRY=" + std::to_string(best));
+    }
+    timer.ResetAndPrint("[perf] Inferred 20 entries by scoring every entry");
+  }
 }
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "config.h"
+#include "interned_args.h"
 #include "method.h"
 
 #include <optional.h>
@@ -17,7 +18,7 @@ struct WorkingFiles;
 struct Project {
   struct Entry {
     AbsolutePath filename;
-    std::vector<std::string> args;
+    InternedArgs args;
     // If true, this entry is inferred and was not read from disk.
     bool is_inferred = false;
   };
@@ -30,6 +31,25 @@ struct Project {
   std::vector<Entry> entries;
   spp::sparse_hash_map<AbsolutePath, int> absolute_path_to_entry_index_;
 
+  // Filename ordered view of |entries| used to infer entries for files which
+  // are not part of the project.
+  struct InferenceIndex {
+    // Indices into |entries| sorted by filename.
+    std::vector<int> sorted;
+    // Minimum number of '/' in the filenames of sorted[0, i) and sorted[i, n).
+    std::vector<int> min_slashes_before;
+    std::vector<int> min_slashes_from;
+  };
+
+  // Guards |inference_index_| and |inferred_entry_index_|, since entries are
+  // inferred from both the querydb and the completion threads.
+  std::mutex inference_mutex_;
+  // Rebuilt lazily whenever the number of entries changes.
+  InferenceIndex inference_index_;
+  // Files which are not in the project -> index of the entry their arguments
+  // are inferred from, or -1 if the project is empty.
+  spp::sparse_hash_map<AbsolutePath, int> inferred_entry_index_;
+
   // Loads a project for the given |directory|.
   //
   // If |g_config->compilationDatabaseDirectory| is not empty, look for .cquery
@@ -41,10 +61,20 @@ struct Project {
   // will affect flags in their subtrees (relative paths are relative to the
   // project root, not subdirectories). For compile_commands.json, its entries
   // are indexed.
-  void Load(const AbsolutePath& root_directory);
+  //
+  // Compilation entries are processed on multiple threads. If |on_entry| is
+  // set it is called on the calling thread for every entry as soon as it is
+  // ready, before Load returns.
+  //
+  // The processed entries are saved to the cache directory and reused on the
+  // next load as long as the compile commands, the relevant configuration and
+  // the compiler drivers used for system include discovery are unchanged.
+  void Load(const AbsolutePath& root_directory,
+            std::function<void(int i, const Entry& entry)> on_entry = nullptr);
 
   // Lookup the CompilationEntry for |filename|. If no entry was found this
-  // will infer one based on existing project structure.
+  // will infer one based on existing project structure. Inferred results are
+  // cached until |entries| is reloaded or grows.
   Entry FindCompilationEntryForFile(const AbsolutePath& filename);
 
   // If the client has overridden the flags, or specified them for a file
@@ -58,4 +88,11 @@ struct Project {
       std::function<void(int i, const Entry& entry)> action);
 
   void Index(QueueManager* queue, WorkingFiles* working_files, lsRequestId id);
+
+  // Same as calling Load and then Index, except that index requests are
+  // dispatched while the project is still loading.
+  void LoadAndIndex(const AbsolutePath& root_directory,
+                    QueueManager* queue,
+                    WorkingFiles* working_files,
+                    lsRequestId id);
 };
@@ -8,9 +8,11 @@
 #include <optional.h>
 #include <loguru.hpp>
 
+#include <algorithm>
 #include <cassert>
 #include <cstdint>
 #include <functional>
+#include <iterator>
 #include <string>
 #include <unordered_map>
 #include <unordered_set>
@@ -215,6 +217,22 @@ void CompareGroups(std::vector<T>& previous_data,
   }
 }
 
+// Fills |max_end| for the subtree of QueryFile::Def::all_symbols_max_end over
+// [lo, hi) and returns the largest end in it.
+Position BuildMaxEnd(const std::vector<QueryId::SymbolRef>& symbols,
+                     std::vector<Position>* max_end,
+                     size_t lo,
+                     size_t hi) {
+  if (lo >= hi)
+    return Position();
+  size_t mid = lo + (hi - lo) / 2;
+  Position result = symbols[mid].range.end;
+  result = std::max(result, BuildMaxEnd(symbols, max_end, lo, mid));
+  result = std::max(result, BuildMaxEnd(symbols, max_end, mid + 1, hi));
+  (*max_end)[mid] = result;
+  return result;
+}
+
 QueryFile::DefUpdate BuildFileDefUpdate(const IdMap& id_map,
                                         const IndexFile& indexed) {
   QueryFile::Def def;
@@ -309,10 +327,24 @@ QueryFile::DefUpdate BuildFileDefUpdate(const IdMap& id_map,
             [](const QueryId::SymbolRef& a, const QueryId::SymbolRef& b) {
               return a.range.start < b.range.start;
             });
+  def.all_symbols_max_end.resize(def.all_symbols.size());
+  BuildMaxEnd(def.all_symbols, &def.all_symbols_max_end, 0,
+              def.all_symbols.size());
 
   return QueryFile::DefUpdate{id_map.primary_file, indexed.file_contents, def};
 }
 
+// Returns |path| without the extension of its file name, if any. The leading
+// dot of a name such as ".clang-format" does not start an extension.
+std::string GetPathStem(const std::string& path) {
+  size_t name_start = path.find_last_of('/');
+  name_start = name_start == std::string::npos ? 0 : name_start + 1;
+  size_t dot = path.find_last_of('.');
+  if (dot == std::string::npos || dot <= name_start)
+    return path;
+  return path.substr(0, dot);
+}
+
 Maybe<QueryId::File> GetQueryFileIdFromPath(QueryDatabase* query_db,
                                             const AbsolutePath& path) {
   auto it = query_db->usr_to_file.find(path);
@@ -321,6 +353,7 @@ Maybe<QueryId::File> GetQueryFileIdFromPath(QueryDatabase* query_db,
 
   RawId idx = query_db->files.size();
   query_db->usr_to_file[path] = QueryId::File(idx);
+  query_db->path_stem_to_files[GetPathStem(path.path)].push_back(idx);
   query_db->files.push_back(QueryFile(path));
   return QueryId::File(idx);
 }
@@ -783,6 +816,184 @@ void QueryDatabase::Remove(const std::vector<WithId<QueryId::File, QueryId::Var>
   }
 }
 
+namespace {
+
+// Returns the sorted, unique ids of |paths|, adding files which are not in
+// |db| yet.
+std::vector<RawId> GetFileIds(QueryDatabase* db,
+                              const std::vector<AbsolutePath>& paths) {
+  std::vector<RawId> ids;
+  ids.reserve(paths.size());
+  for (const AbsolutePath& path : paths)
+    ids.push_back(GetQueryFileIdFromPath(db, path)->id);
+  std::sort(ids.begin(), ids.end());
+  ids.erase(std::unique(ids.begin(), ids.end()), ids.end());
+  return ids;
+}
+
+// Updates |db->file_dependents| after the dependencies of |file| changed from
+// |previous| to |current|, both sorted. Only the difference is touched.
+void UpdateFileDependents(QueryDatabase* db,
+                          QueryId::File file,
+                          std::vector<RawId> previous,
+                          std::vector<RawId> current) {
+  std::vector<RawId> removed, added;
+  std::set_difference(previous.begin(), previous.end(), current.begin(),
+                      current.end(), std::back_inserter(removed));
+  std::set_difference(current.begin(), current.end(), previous.begin(),
+                      previous.end(), std::back_inserter(added));
+  if (db->file_dependents.size() < db->files.size())
+    db->file_dependents.resize(db->files.size());
+
+  for (RawId dependency : removed) {
+    std::vector<RawId>& dependents = db->file_dependents[dependency];
+    auto it = std::lower_bound(dependents.begin(), dependents.end(), file.id);
+    if (it != dependents.end() && *it == file.id)
+      dependents.erase(it);
+  }
+  for (RawId dependency : added) {
+    std::vector<RawId>& dependents = db->file_dependents[dependency];
+    auto it = std::lower_bound(dependents.begin(), dependents.end(), file.id);
+    if (it == dependents.end() || *it != file.id)
+      dependents.insert(it, file.id);
+  }
+}
+
+bool SameIncludes(const std::vector<IndexInclude>& a,
+                  const std::vector<IndexInclude>& b) {
+  return a.size() == b.size() &&
+         std::equal(a.begin(), a.end(), b.begin(),
+                    [](const IndexInclude& x, const IndexInclude& y) {
+                      return x.line == y.line &&
+                             x.resolved_path == y.resolved_path;
+                    });
+}
+
+// Updates |db->resolved_path_to_includes| after the includes of |file| changed
+// from |previous| to |current|.
+void UpdateIncludeLocations(QueryDatabase* db,
+                            QueryId::File file,
+                            const std::vector<IndexInclude>& previous,
+                            const std::vector<IndexInclude>& current) {
+  if (SameIncludes(previous, current))
+    return;
+
+  for (const IndexInclude& include : previous) {
+    auto it = db->resolved_path_to_includes.find(include.resolved_path);
+    if (it == db->resolved_path_to_includes.end())
+      continue;
+    std::vector<QueryDatabase::IncludeLocation>& locations = it->second;
+    QueryDatabase::IncludeLocation location{file.id, include.line};
+    auto pos = std::lower_bound(locations.begin(), locations.end(), location);
+    if (pos != locations.end() && pos->file == file.id &&
+        pos->line == include.line)
+      locations.erase(pos);
+    if (locations.empty())
+      db->resolved_path_to_includes.erase(it);
+  }
+  for (const IndexInclude& include : current) {
+    std::vector<QueryDatabase::IncludeLocation>& locations =
+        db->resolved_path_to_includes[include.resolved_path];
+    QueryDatabase::IncludeLocation location{file.id, include.line};
+    auto pos = std::lower_bound(locations.begin(), locations.end(), location);
+    if (pos == locations.end() || pos->file != file.id ||
+        pos->line != include.line)
+      locations.insert(pos, location);
+  }
+}
+
+}  // namespace
+
+const std::vector<RawId>& QueryDatabase::GetFileDependents(
+    QueryId::File file) const {
+  static const std::vector<RawId> kEmpty;
+  if (file.id >= file_dependents.size())
+    return kEmpty;
+  return file_dependents[file.id];
+}
+
+const std::vector<QueryDatabase::IncludeLocation>& QueryDatabase::GetIncludesOf(
+    const std::string& resolved_path) const {
+  static const std::vector<IncludeLocation> kEmpty;
+  auto it = resolved_path_to_includes.find(resolved_path);
+  if (it == resolved_path_to_includes.end())
+    return kEmpty;
+  return it->second;
+}
+
+const std::vector<QueryId::Func>& FuncHierarchyCache::GetClosure(
+    QueryDatabase* db,
+    QueryId::Func root,
+    bool derived) {
+  Grow(db->funcs.size());
+  uint64_t epoch = epoch_[FindComponent(root.id)];
+  std::unordered_map<RawId, Closure>& closures = derived ? derived_ : bases_;
+  auto it = closures.find(root.id);
+  if (it != closures.end() && it->second.epoch == epoch)
+    return it->second.funcs;
+
+  Closure& closure = closures[root.id];
+  closure.epoch = epoch;
+  closure.funcs.clear();
+  std::vector<QueryId::Func> stack{root};
+  std::unordered_set<RawId> seen{root.id};
+  while (!stack.empty()) {
+    const QueryFunc& func = db->funcs[stack.back().id];
+    stack.pop_back();
+    const std::vector<QueryId::Func>* next = &func.derived;
+    if (!derived) {
+      const QueryFunc::Def* def = func.AnyDef();
+      if (!def)
+        continue;
+      next = &def->bases;
+    }
+    for (QueryId::Func func1 : *next) {
+      if (db->funcs[func1.id].def.empty() || !seen.insert(func1.id).second)
+        continue;
+      stack.push_back(func1);
+      closure.funcs.push_back(func1);
+    }
+  }
+  return closure.funcs;
+}
+
+void FuncHierarchyCache::OnChange(QueryId::Func func,
+                                  const std::vector<QueryId::Func>& linked) {
+  Grow(func.id + 1);
+  RawId component = FindComponent(func.id);
+  for (QueryId::Func func1 : linked) {
+    Grow(func1.id + 1);
+    RawId component1 = FindComponent(func1.id);
+    if (component1 != component)
+      parent_[component1] = component;
+  }
+  epoch_[component] = ++next_epoch_;
+}
+
+void FuncHierarchyCache::Grow(size_t size) {
+  for (RawId i = parent_.size(); i < size; i++) {
+    parent_.push_back(i);
+    epoch_.push_back(0);
+  }
+}
+
+RawId FuncHierarchyCache::FindComponent(RawId func) {
+  while (parent_[func] != func) {
+    // Path halving.
+    parent_[func] = parent_[parent_[func]];
+    func = parent_[func];
+  }
+  return func;
+}
+
+std::vector<RawId> QueryDatabase::GetFilesWithSameStem(
+    const AbsolutePath& path) const {
+  auto it = path_stem_to_files.find(GetPathStem(path.path));
+  if (it == path_stem_to_files.end())
+    return {};
+  return it->second;
+}
+
 void QueryDatabase::ApplyIndexUpdate(IndexUpdate* update) {
 // This function runs on the querydb thread.
 
@@ -799,8 +1010,18 @@ void QueryDatabase::ApplyIndexUpdate(IndexUpdate* update) {
     VerifyUnique(def.def_var_name);                                   \
   }
 
-  for (const AbsolutePath& filename : update->files_removed)
-    files[usr_to_file[filename].id].def = nullopt;
+  generation++;
+
+  for (const AbsolutePath& filename : update->files_removed) {
+    QueryId::File file_id = usr_to_file[filename];
+    QueryFile& file = files[file_id.id];
+    if (file.def) {
+      UpdateFileDependents(this, file_id,
+                           GetFileIds(this, file.def->dependencies), {});
+      UpdateIncludeLocations(this, file_id, file.def->includes, {});
+    }
+    file.def = nullopt;
+  }
   ImportOrUpdate(update->files_def_update);
 
   Remove(update->types_removed);
@@ -810,6 +1031,12 @@ void QueryDatabase::ApplyIndexUpdate(IndexUpdate* update) {
   HANDLE_MERGEABLE(types_instances, instances, types);
   HANDLE_MERGEABLE(types_uses, uses, types);
 
+  for (const auto& entry : update->funcs_removed)
+    func_hierarchy.OnChange(entry.value, {});
+  for (const QueryFunc::DefUpdate& def : update->funcs_def_update)
+    func_hierarchy.OnChange(def.id, def.value.bases);
+  for (const QueryFunc::DerivedUpdate& derived : update->funcs_derived)
+    func_hierarchy.OnChange(derived.id, derived.to_add);
   Remove(update->funcs_removed);
   ImportOrUpdate(std::move(update->funcs_def_update));
   HANDLE_MERGEABLE(funcs_declarations, declarations, funcs);
@@ -830,10 +1057,23 @@ void QueryDatabase::ImportOrUpdate(
 
   for (auto& def : updates) {
     assert(def.id.id >= 0 && def.id.id < files.size());
-    QueryFile& existing = files[def.id.id];
+    // Previous dependencies already have ids, but new ones may add files, so
+    // look them up before taking a reference into |files|.
+    std::vector<RawId> previous_dependencies;
+    if (files[def.id.id].def)
+      previous_dependencies = GetFileIds(this, files[def.id.id].def->dependencies);
+    UpdateFileDependents(this, def.id, std::move(previous_dependencies),
+                         GetFileIds(this, def.value.dependencies));
 
+    QueryFile& existing = files[def.id.id];
+    static const std::vector<IndexInclude> kNoIncludes;
+    UpdateIncludeLocations(this, def.id,
+                           existing.def ? existing.def->includes : kNoIncludes,
+                           def.value.includes);
+    std::string previous_short_name = GetShortNameOf(existing.symbol_idx);
     existing.def = def.value;
-    UpdateSymbols(&existing.symbol_idx, SymbolKind::File, def.id);
+    UpdateSymbols(&existing.symbol_idx, SymbolKind::File, def.id,
+                  previous_short_name);
   }
 }
 
@@ -845,10 +1085,11 @@ void QueryDatabase::ImportOrUpdate(
     assert(!def.value.detailed_name.empty());
     assert(def.id.id >= 0 && def.id.id < types.size());
     QueryType& existing = types[def.id.id];
-    if (!TryReplaceDef(existing.def, std::move(def.value))) {
+    std::string previous_short_name = GetShortNameOf(existing.symbol_idx);
+    if (!TryReplaceDef(existing.def, std::move(def.value)))
       PushFront(existing.def, std::move(def.value));
-      UpdateSymbols(&existing.symbol_idx, SymbolKind::Type, def.id);
-    }
+    UpdateSymbols(&existing.symbol_idx, SymbolKind::Type, def.id,
+                  previous_short_name);
   }
 }
 
@@ -860,10 +1101,11 @@ void QueryDatabase::ImportOrUpdate(
     assert(!def.value.detailed_name.empty());
     assert(def.id.id >= 0 && def.id.id < funcs.size());
     QueryFunc& existing = funcs[def.id.id];
-    if (!TryReplaceDef(existing.def, std::move(def.value))) {
+    std::string previous_short_name = GetShortNameOf(existing.symbol_idx);
+    if (!TryReplaceDef(existing.def, std::move(def.value)))
       PushFront(existing.def, std::move(def.value));
-      UpdateSymbols(&existing.symbol_idx, SymbolKind::Func, def.id);
-    }
+    UpdateSymbols(&existing.symbol_idx, SymbolKind::Func, def.id,
+                  previous_short_name);
   }
 }
 
@@ -874,21 +1116,53 @@ void QueryDatabase::ImportOrUpdate(std::vector<QueryVar::DefUpdate>&& updates) {
     assert(!def.value.detailed_name.empty());
     assert(def.id.id >= 0 && def.id.id < vars.size());
     QueryVar& existing = vars[def.id.id];
-    if (!TryReplaceDef(existing.def, std::move(def.value))) {
+    std::string previous_short_name = GetShortNameOf(existing.symbol_idx);
+    bool replaced = TryReplaceDef(existing.def, std::move(def.value));
+    if (!replaced)
       PushFront(existing.def, std::move(def.value));
-      if (!existing.def.front().is_local())
-        UpdateSymbols(&existing.symbol_idx, SymbolKind::Var, def.id);
+    if (existing.symbol_idx != size_t(-1) ||
+        (!replaced && !existing.def.front().is_local())) {
+      UpdateSymbols(&existing.symbol_idx, SymbolKind::Var, def.id,
+                    previous_short_name);
     }
   }
 }
 
 void QueryDatabase::UpdateSymbols(size_t* symbol_idx,
                                   SymbolKind kind,
-                                  AnyId idx) {
+                                  AnyId idx,
+                                  const std::string& previous_short_name) {
   if (*symbol_idx == -1) {
     *symbol_idx = symbols.size();
     symbols.push_back(SymbolIdx{idx, kind});
   }
+
+  // Re-key the symbol if its def was replaced under a different name.
+  std::string_view short_name = GetSymbolShortName(*symbol_idx);
+  if (short_name == previous_short_name)
+    return;
+  if (!previous_short_name.empty()) {
+    auto it = short_name_to_symbols.find(previous_short_name);
+    if (it != short_name_to_symbols.end()) {
+      std::vector<RawId>& ids = it->second;
+      auto id = std::lower_bound(ids.begin(), ids.end(), (RawId)*symbol_idx);
+      if (id != ids.end() && *id == *symbol_idx)
+        ids.erase(id);
+      if (ids.empty())
+        short_name_to_symbols.erase(it);
+    }
+  }
+  if (!short_name.empty()) {
+    std::vector<RawId>& ids = short_name_to_symbols[std::string(short_name)];
+    ids.insert(std::lower_bound(ids.begin(), ids.end(), (RawId)*symbol_idx),
+               *symbol_idx);
+  }
+}
+
+std::string QueryDatabase::GetShortNameOf(size_t symbol_idx) const {
+  if (symbol_idx == size_t(-1))
+    return "";
+  return std::string(GetSymbolShortName(symbol_idx));
 }
 
 // For Func, the returned name does not include parameters.
@@ -942,6 +1216,39 @@ std::string_view QueryDatabase::GetSymbolShortName(RawId symbol_idx) const {
   return "";
 }
 
+void QueryDatabase::FindSymbolsByShortName(
+    std::string_view short_name,
+    bool include_prefix_matches,
+    const std::function<bool(RawId)>& fn) const {
+  std::string key(short_name);
+  for (auto it = short_name_to_symbols.lower_bound(key);
+       it != short_name_to_symbols.end(); ++it) {
+    if (it->first.compare(0, key.size(), key) != 0)
+      break;
+    if (!include_prefix_matches && it->first.size() != key.size())
+      break;
+    for (RawId symbol_idx : it->second) {
+      // Skip symbols which were removed or renamed after they were indexed.
+      if (symbols[symbol_idx].kind == SymbolKind::Invalid ||
+          GetSymbolShortName(symbol_idx) != it->first)
+        continue;
+      if (!fn(symbol_idx))
+        return;
+    }
+  }
+}
+
+std::vector<RawId> QueryDatabase::GetSymbolsByShortName(
+    std::string_view short_name) const {
+  std::vector<RawId> result;
+  FindSymbolsByShortName(short_name, false /*include_prefix_matches*/,
+                         [&](RawId symbol_idx) {
+                           result.push_back(symbol_idx);
+                           return true;
+                         });
+  return result;
+}
+
 QueryFile& QueryDatabase::GetFile(QueryId::File id) {
   return files[id.id];
 }
@@ -1105,6 +1412,204 @@ TEST_SUITE("query") {
     REQUIRE(db.funcs[0].uses[1].range == Range(Position(5, 0)));
   }
 
+  TEST_CASE("file dependents") {
+    QueryDatabase db;
+    auto update_file = [&](const char* path,
+                           std::vector<AbsolutePath> dependencies) {
+      IndexFile file{AbsolutePath(path)};
+      file.dependencies = dependencies;
+      IdMap id_map(&db, file.id_cache);
+      IndexUpdate update =
+          IndexUpdate::CreateDelta(nullptr, &id_map, nullptr, &file);
+      db.ApplyIndexUpdate(&update);
+    };
+    auto dependents = [&](const char* path) {
+      std::vector<std::string> result;
+      for (RawId id : db.GetFileDependents(db.usr_to_file[AbsolutePath(path)]))
+        result.push_back(db.files[id].def->path);
+      return result;
+    };
+
+    update_file("a.cc", {AbsolutePath("a.h"), AbsolutePath("common.h")});
+    update_file("b.cc", {AbsolutePath("common.h")});
+    REQUIRE(dependents("common.h") == std::vector<std::string>{"a.cc", "b.cc"});
+    REQUIRE(dependents("a.h") == std::vector<std::string>{"a.cc"});
+    REQUIRE(dependents("a.cc").empty());
+
+    update_file("a.cc", {AbsolutePath("a.h")});
+    REQUIRE(dependents("common.h") == std::vector<std::string>{"b.cc"});
+    REQUIRE(dependents("a.h") == std::vector<std::string>{"a.cc"});
+
+    update_file("b.cc", {});
+    REQUIRE(dependents("common.h").empty());
+
+    std::vector<RawId> a_files = db.GetFilesWithSameStem(AbsolutePath("a.cc"));
+    REQUIRE(a_files.size() == 2);
+    REQUIRE(a_files == db.GetFilesWithSameStem(AbsolutePath("a.hpp")));
+    REQUIRE(db.GetFilesWithSameStem(AbsolutePath("common.cc")) ==
+            std::vector<RawId>{db.usr_to_file[AbsolutePath("common.h")].id});
+    REQUIRE(db.GetFilesWithSameStem(AbsolutePath("c.h")).empty());
+  }
+
+  TEST_CASE("include locations") {
+    QueryDatabase db;
+    auto update_file = [&](const char* path,
+                           std::vector<IndexInclude> includes) {
+      IndexFile file{AbsolutePath(path)};
+      file.includes = includes;
+      IdMap id_map(&db, file.id_cache);
+      IndexUpdate update =
+          IndexUpdate::CreateDelta(nullptr, &id_map, nullptr, &file);
+      db.ApplyIndexUpdate(&update);
+    };
+    auto includes_of = [&](const char* path) {
+      std::vector<std::pair<std::string, int>> result;
+      for (const QueryDatabase::IncludeLocation& include :
+           db.GetIncludesOf(path))
+        result.emplace_back(db.files[include.file].def->path, include.line);
+      return result;
+    };
+    using Result = std::vector<std::pair<std::string, int>>;
+
+    update_file("a.cc", {{1, "a.h"}, {2, "common.h"}});
+    update_file("b.cc", {{3, "common.h"}});
+    REQUIRE(includes_of("common.h") == Result{{"a.cc", 2}, {"b.cc", 3}});
+    REQUIRE(includes_of("a.h") == Result{{"a.cc", 1}});
+
+    update_file("a.cc", {{1, "common.h"}});
+    REQUIRE(includes_of("common.h") == Result{{"a.cc", 1}, {"b.cc", 3}});
+    REQUIRE(includes_of("a.h").empty());
+    REQUIRE(db.resolved_path_to_includes.size() == 1);
+  }
+
+  TEST_CASE("func hierarchy closure") {
+    // c overrides b, which overrides a.
+    auto make_file = [](bool c_overrides_b) {
+      auto file = std::make_unique<IndexFile>(AbsolutePath("foo.cc"));
+      IndexId::Func a = file->ToFuncId(HashUsr("a"));
+      IndexId::Func b = file->ToFuncId(HashUsr("b"));
+      IndexId::Func c = file->ToFuncId(HashUsr("c"));
+      for (IndexId::Func id : {a, b, c})
+        file->Resolve(id)->def.detailed_name = "void f()";
+      file->Resolve(b)->def.bases.push_back(a);
+      file->Resolve(a)->derived.push_back(b);
+      if (c_overrides_b) {
+        file->Resolve(c)->def.bases.push_back(b);
+        file->Resolve(b)->derived.push_back(c);
+      }
+      return file;
+    };
+
+    QueryDatabase db;
+    std::unique_ptr<IndexFile> previous = make_file(true);
+    IdMap previous_id_map(&db, previous->id_cache);
+    IndexUpdate update = IndexUpdate::CreateDelta(nullptr, &previous_id_map,
+                                                  nullptr, previous.get());
+    db.ApplyIndexUpdate(&update);
+
+    QueryId::Func a = db.usr_to_func[HashUsr("a")];
+    QueryId::Func b = db.usr_to_func[HashUsr("b")];
+    QueryId::Func c = db.usr_to_func[HashUsr("c")];
+    using Funcs = std::vector<QueryId::Func>;
+    REQUIRE(db.func_hierarchy.GetClosure(&db, c, false) == Funcs{b, a});
+    REQUIRE(db.func_hierarchy.GetClosure(&db, a, true) == Funcs{b, c});
+    REQUIRE(db.func_hierarchy.GetClosure(&db, a, true) == Funcs{b, c});
+
+    // Nested lookups do not invalidate earlier results.
+    const Funcs& bases_of_c = db.func_hierarchy.GetClosure(&db, c, false);
+    for (QueryId::Func func : {a, b, c})
+      for (bool derived : {false, true})
+        db.func_hierarchy.GetClosure(&db, func, derived);
+    REQUIRE(bases_of_c == Funcs{b, a});
+
+    std::unique_ptr<IndexFile> current = make_file(false);
+    IdMap current_id_map(&db, current->id_cache);
+    update = IndexUpdate::CreateDelta(&previous_id_map, &current_id_map,
+                                      previous.get(), current.get());
+    db.ApplyIndexUpdate(&update);
+    REQUIRE(db.func_hierarchy.GetClosure(&db, c, false).empty());
+    REQUIRE(db.func_hierarchy.GetClosure(&db, a, true) == Funcs{b});
+  }
+
+  TEST_CASE("symbols by short name") {
+    IndexFile file{AbsolutePath("foo.cc")};
+    auto add_func = [&](const char* usr, const char* detailed_name,
+                        int16_t short_name_offset, int16_t short_name_size) {
+      IndexFunc* func = file.Resolve(file.ToFuncId(HashUsr(usr)));
+      func->def.detailed_name = detailed_name;
+      func->def.short_name_offset = short_name_offset;
+      func->def.short_name_size = short_name_size;
+    };
+    add_func("a", "void ns::foo()", 9, 3);
+    add_func("b", "void foo()", 5, 3);
+    add_func("c", "void foobar()", 5, 6);
+
+    QueryDatabase db;
+    IdMap id_map(&db, file.id_cache);
+    IndexUpdate update =
+        IndexUpdate::CreateDelta(nullptr, &id_map, nullptr, &file);
+    db.ApplyIndexUpdate(&update);
+
+    std::vector<RawId> found = db.GetSymbolsByShortName("foo");
+    REQUIRE(found.size() == 2);
+    REQUIRE(found[0] < found[1]);
+    for (RawId i : found)
+      REQUIRE(db.GetSymbolShortName(i) == "foo");
+    REQUIRE(db.GetSymbolsByShortName("foobar").size() == 1);
+    REQUIRE(db.GetSymbolsByShortName("bar").empty());
+
+    std::vector<std::string> names;
+    db.FindSymbolsByShortName("foo", true /*include_prefix_matches*/,
+                              [&](RawId i) {
+                                names.push_back(
+                                    std::string(db.GetSymbolShortName(i)));
+                                return names.size() < 3;
+                              });
+    REQUIRE(names == std::vector<std::string>{"foo", "foo", "foobar"});
+    names.clear();
+    db.FindSymbolsByShortName("foo", true /*include_prefix_matches*/,
+                              [&](RawId i) {
+                                names.push_back(
+                                    std::string(db.GetSymbolShortName(i)));
+                                return false;
+                              });
+    REQUIRE(names.size() == 1);
+  }
+
+  TEST_CASE("symbols by short name after rename") {
+    auto make_file = [](const char* detailed_name) {
+      auto file = std::make_unique<IndexFile>(AbsolutePath("foo.cc"));
+      IndexFunc* func = file->Resolve(file->ToFuncId(HashUsr("a")));
+      func->def.detailed_name = detailed_name;
+      func->def.short_name_offset = 5;
+      func->def.short_name_size = 3;
+      return file;
+    };
+
+    QueryDatabase db;
+    std::unique_ptr<IndexFile> previous = make_file("void foo()");
+    IdMap previous_id_map(&db, previous->id_cache);
+    IndexUpdate update =
+        IndexUpdate::CreateDelta(nullptr, &previous_id_map, nullptr,
+                                 previous.get());
+    db.ApplyIndexUpdate(&update);
+    REQUIRE(db.GetSymbolsByShortName("foo").size() == 1);
+
+    // Reimporting the file replaces the def in place.
+    std::unique_ptr<IndexFile> current = make_file("void bar()");
+    IdMap current_id_map(&db, current->id_cache);
+    update = IndexUpdate::CreateDelta(&previous_id_map, &current_id_map,
+                                      previous.get(), current.get());
+    db.ApplyIndexUpdate(&update);
+    REQUIRE(db.funcs.size() == 1);
+    REQUIRE(db.funcs[0].def.size() == 1);
+    REQUIRE(db.GetSymbolsByShortName("foo").empty());
+    REQUIRE(db.short_name_to_symbols.count("foo") == 0);
+    std::vector<RawId> found = db.GetSymbolsByShortName("bar");
+    REQUIRE(found.size() == 1);
+    REQUIRE(db.GetSymbolShortName(found[0]) == "bar");
+  }
+
   TEST_CASE("Remove variable with usage") {
     auto load_index_from_json = [](const char* json) {
       return Deserialize(SerializeFormat::Json,
@@ -6,6 +6,8 @@
 #include <sparsepp/spp.h>
 
 #include <functional>
+#include <map>
+#include <unordered_map>
 
 struct QueryFile;
 struct QueryType;
@@ -106,8 +108,13 @@ struct QueryFile {
     std::vector<IndexInclude> includes;
     // Outline of the file (ie, for code lens).
     std::vector<QueryId::SymbolRef> outline;
-    // Every symbol found in the file (ie, for goto definition)
+    // Every symbol found in the file (ie, for goto definition), sorted by
+    // range start.
     std::vector<QueryId::SymbolRef> all_symbols;
+    // Implicit interval tree over |all_symbols|: the element in the middle of
+    // a range is the root of that range's subtree, and its entry here is the
+    // largest range end in the subtree. Built by BuildFileDefUpdate.
+    std::vector<Position> all_symbols_max_end;
     // Parts of the file which are disabled.
     std::vector<Range> inactive_regions;
     // Used by |$cquery/freshenIndex|.
@@ -241,9 +248,51 @@ struct IndexUpdate {
               IndexFile& current);
 };
 
+// Transitive bases and derived functions, cached until the hierarchy around
+// them changes. Functions linked by base/derived edges are grouped into
+// components with a union-find, and any change to a member gives its component
+// a new epoch, which invalidates the closures computed within it. Components
+// are only ever merged, so unrelated hierarchies keep their closures.
+struct FuncHierarchyCache {
+  // Returns the functions with a definition which are reachable from |root|
+  // through def bases, or through derived if |derived| is true, in depth-first
+  // order. |root| is not included. The result stays valid until the next
+  // OnChange, also across other GetClosure calls.
+  const std::vector<QueryId::Func>& GetClosure(QueryDatabase* db,
+                                               QueryId::Func root,
+                                               bool derived);
+
+  // Must be called when the defs or derived list of |func| change. |linked|
+  // are the functions which it is being linked to.
+  void OnChange(QueryId::Func func, const std::vector<QueryId::Func>& linked);
+
+ private:
+  struct Closure {
+    uint64_t epoch;
+    std::vector<QueryId::Func> funcs;
+  };
+
+  // Ensures that functions with ids below |size| have a component.
+  void Grow(size_t size);
+  RawId FindComponent(RawId func);
+
+  std::vector<RawId> parent_;
+  // Epoch of each component, valid for component roots.
+  std::vector<uint64_t> epoch_;
+  uint64_t next_epoch_ = 0;
+  // Node based, so that references returned by GetClosure are not moved by
+  // later insertions.
+  std::unordered_map<RawId, Closure> bases_;
+  std::unordered_map<RawId, Closure> derived_;
+};
+
 // The query database is heavily optimized for fast queries. It is stored
 // in-memory.
 struct QueryDatabase {
+  // Incremented by every ApplyIndexUpdate, so that results derived from the
+  // database can be cached until it changes.
+  uint64_t generation = 0;
+
   // All File/Func/Type/Var symbols.
   std::vector<SymbolIdx> symbols;
 
@@ -259,6 +308,40 @@ struct QueryDatabase {
   spp::sparse_hash_map<Usr, QueryId::Func> usr_to_func;
   spp::sparse_hash_map<Usr, QueryId::Var> usr_to_var;
 
+  // Reverse of QueryFile::Def::dependencies, indexed by file id: the files
+  // which depend on a file, ie, the translation units which include a header.
+  // Each list is sorted. Kept up to date by ApplyIndexUpdate.
+  std::vector<std::vector<RawId>> file_dependents;
+
+  // Files by path without extension, eg, "/src/foo" for "/src/foo.cc", so that
+  // headers can be paired with their source files. Kept up to date by
+  // GetQueryFileIdFromPath.
+  spp::sparse_hash_map<std::string, std::vector<RawId>> path_stem_to_files;
+
+  // An #include directive on |line| of |file|.
+  struct IncludeLocation {
+    RawId file;
+    int line;
+
+    bool operator<(const IncludeLocation& o) const {
+      return file != o.file ? file < o.file : line < o.line;
+    }
+  };
+  // Reverse of QueryFile::Def::includes: the directives which include each
+  // resolved path, sorted by file and line. Kept up to date by
+  // ApplyIndexUpdate.
+  spp::sparse_hash_map<std::string, std::vector<IncludeLocation>>
+      resolved_path_to_includes;
+
+  // Indices into |symbols| by short name, in increasing order. Ordered so that
+  // names with a common prefix can be enumerated. UpdateSymbols moves a symbol
+  // when a new def changes its name, but removed symbols are not erased, so
+  // lookups must go through FindSymbolsByShortName, which verifies them.
+  std::map<std::string, std::vector<RawId>> short_name_to_symbols;
+
+  // Kept up to date by ApplyIndexUpdate.
+  FuncHierarchyCache func_hierarchy;
+
   // Removes data for the given ids in the given files.
   void Remove(const std::vector<WithId<QueryId::File, QueryId::Type>>& to_remove);
   void Remove(const std::vector<WithId<QueryId::File, QueryId::Func>>& to_remove);
@@ -270,9 +353,35 @@ struct QueryDatabase {
   void ImportOrUpdate(std::vector<QueryType::DefUpdate>&& updates);
   void ImportOrUpdate(std::vector<QueryFunc::DefUpdate>&& updates);
   void ImportOrUpdate(std::vector<QueryVar::DefUpdate>&& updates);
-  void UpdateSymbols(size_t* symbol_idx, SymbolKind kind, AnyId idx);
+  // |previous_short_name| is the short name of the symbol before its def was
+  // updated, see GetShortNameOf.
+  void UpdateSymbols(size_t* symbol_idx,
+                     SymbolKind kind,
+                     AnyId idx,
+                     const std::string& previous_short_name);
+  // Short name of |symbol_idx|, or empty if it is -1.
+  std::string GetShortNameOf(size_t symbol_idx) const;
   std::string_view GetSymbolDetailedName(RawId symbol_idx) const;
   std::string_view GetSymbolShortName(RawId symbol_idx) const;
+  // Calls |fn| with the valid symbols whose short name is |short_name| and
+  // then, if |include_prefix_matches| is true, with those whose short name
+  // starts with it, ordered by name. Stops as soon as |fn| returns false, so
+  // callers can apply their result limits without visiting other symbols.
+  void FindSymbolsByShortName(std::string_view short_name,
+                              bool include_prefix_matches,
+                              const std::function<bool(RawId)>& fn) const;
+  // Returns the valid symbols whose short name is |short_name|, in increasing
+  // order.
+  std::vector<RawId> GetSymbolsByShortName(std::string_view short_name) const;
+
+  // Returns the ids of the files which list |file| as a dependency.
+  const std::vector<RawId>& GetFileDependents(QueryId::File file) const;
+  // Returns the files whose path only differs from |path| in its extension,
+  // including |path| itself if it is known.
+  std::vector<RawId> GetFilesWithSameStem(const AbsolutePath& path) const;
+  // Returns the #include directives which include |resolved_path|.
+  const std::vector<IncludeLocation>& GetIncludesOf(
+      const std::string& resolved_path) const;
 
   QueryFile& GetFile(QueryId::File id);
   QueryFunc& GetFunc(QueryId::Func id);
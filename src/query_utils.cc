@@ -2,9 +2,11 @@
 
 #include "queue_manager.h"
 
+#include <doctest/doctest.h>
 #include <loguru.hpp>
 
 #include <climits>
+#include <unordered_map>
 #include <unordered_set>
 
 namespace {
@@ -125,48 +127,31 @@ std::vector<QueryId::LexicalRef> GetNonDefDeclarations(QueryDatabase* db,
   }
 }
 
-std::vector<QueryId::LexicalRef> GetRefsForAllBases(QueryDatabase* db,
-                                                    QueryFunc& root) {
-  std::vector<QueryId::LexicalRef> ret;
-  std::vector<QueryFunc*> stack{&root};
-  std::unordered_set<Usr> seen;
-  seen.insert(root.usr);
-  while (!stack.empty()) {
-    QueryFunc& func = *stack.back();
-    stack.pop_back();
-    if (auto* def = func.AnyDef()) {
-      EachDefinedFunc(db, def->bases, [&](QueryFunc& func1) {
-        if (!seen.count(func1.usr)) {
-          seen.insert(func1.usr);
-          stack.push_back(&func1);
-          AddRange(&ret, func1.uses);
-        }
-      });
-    }
-  }
+namespace {
 
+std::vector<QueryId::LexicalRef> GetRefsForAllInHierarchy(QueryDatabase* db,
+                                                          QueryFunc& root,
+                                                          bool derived) {
+  std::vector<QueryId::LexicalRef> ret;
+  auto it = db->usr_to_func.find(root.usr);
+  if (it == db->usr_to_func.end())
+    return ret;
+  for (QueryId::Func func : db->func_hierarchy.GetClosure(db, it->second,
+                                                          derived))
+    AddRange(&ret, db->funcs[func.id].uses);
   return ret;
 }
 
+}  // namespace
+
+std::vector<QueryId::LexicalRef> GetRefsForAllBases(QueryDatabase* db,
+                                                    QueryFunc& root) {
+  return GetRefsForAllInHierarchy(db, root, false /*derived*/);
+}
+
 std::vector<QueryId::LexicalRef> GetRefsForAllDerived(QueryDatabase* db,
                                                       QueryFunc& root) {
-  std::vector<QueryId::LexicalRef> ret;
-  std::vector<QueryFunc*> stack{&root};
-  std::unordered_set<Usr> seen;
-  seen.insert(root.usr);
-  while (!stack.empty()) {
-    QueryFunc& func = *stack.back();
-    stack.pop_back();
-    EachDefinedFunc(db, func.derived, [&](QueryFunc& func1) {
-      if (!seen.count(func1.usr)) {
-        seen.insert(func1.usr);
-        stack.push_back(&func1);
-        AddRange(&ret, func1.uses);
-      }
-    });
-  }
-
-  return ret;
+  return GetRefsForAllInHierarchy(db, root, true /*derived*/);
 }
 
 optional<lsPosition> GetLsPosition(WorkingFile* working_file,
@@ -244,23 +229,96 @@ optional<lsLocation> GetLsLocation(QueryDatabase* db,
   return lsLocation(uri, *range);
 }
 
-std::vector<lsLocation> GetLsLocations(
+namespace {
+
+// The ranges of references in one file.
+struct FileRanges {
+  QueryFile* file;
+  std::vector<Range> ranges;
+};
+
+// Groups |refs| by file, skipping references to files which are not indexed
+// anymore.
+std::vector<FileRanges> GroupRangesByFile(
     QueryDatabase* db,
-    WorkingFiles* working_files,
     const std::vector<QueryId::LexicalRef>& refs) {
-  std::vector<lsLocation> result;
+  std::vector<FileRanges> files;
+  std::unordered_map<RawId, size_t> file_to_index;
   for (QueryId::LexicalRef ref : refs) {
-    if (optional<lsLocation> l = GetLsLocation(db, working_files, ref))
-      result.push_back(*l);
+    auto it = file_to_index.find(ref.file.id);
+    if (it == file_to_index.end()) {
+      QueryFile& file = db->files[ref.file.id];
+      if (!file.def)
+        continue;
+      it = file_to_index.emplace(ref.file.id, files.size()).first;
+      files.push_back({&file, {}});
+    }
+    files[it->second].ranges.push_back(ref.range);
   }
+  return files;
+}
 
+// Returns the sorted, unique ranges of |file| in its working file. Ranges
+// which cannot be mapped are dropped.
+std::vector<lsRange> GetUniqueLsRanges(WorkingFiles* working_files,
+                                       const FileRanges& file) {
+  WorkingFile* working_file =
+      working_files->GetFileByFilename(file.file->def->path);
+  std::vector<lsRange> result;
+  for (const Range& range : file.ranges) {
+    if (optional<lsRange> ls_range = GetLsRange(working_file, range))
+      result.push_back(*ls_range);
+  }
   std::sort(result.begin(), result.end());
   result.erase(std::unique(result.begin(), result.end()), result.end());
+  return result;
+}
+
+}  // namespace
+
+std::vector<lsLocation> GetLsLocations(
+    QueryDatabase* db,
+    WorkingFiles* working_files,
+    const std::vector<QueryId::LexicalRef>& refs) {
+  // Group the ranges by file, so that the URI and working file of each file
+  // are only computed once.
+  std::vector<std::pair<lsDocumentUri, FileRanges>> files;
+  for (FileRanges& file : GroupRangesByFile(db, refs))
+    files.emplace_back(lsDocumentUri::FromPath(file.file->def->path),
+                       std::move(file));
+
+  // Locations are sorted by URI first, so files can be resolved in URI order
+  // until there are enough results. Files after that are never mapped.
+  std::sort(files.begin(), files.end(),
+            [](const std::pair<lsDocumentUri, FileRanges>& a,
+               const std::pair<lsDocumentUri, FileRanges>& b) {
+              return a.first.raw_uri_ < b.first.raw_uri_;
+            });
+  std::vector<lsLocation> result;
+  for (const auto& file : files) {
+    if (result.size() >= g_config->xref.maxNum)
+      break;
+    for (const lsRange& range : GetUniqueLsRanges(working_files, file.second))
+      result.emplace_back(file.first, range);
+  }
+
   if (result.size() > g_config->xref.maxNum)
     result.resize(g_config->xref.maxNum);
   return result;
 }
 
+size_t CountLsLocations(QueryDatabase* db,
+                        WorkingFiles* working_files,
+                        const std::vector<QueryId::LexicalRef>& refs) {
+  size_t count = 0;
+  for (const FileRanges& file : GroupRangesByFile(db, refs)) {
+    if (count >= g_config->xref.maxNum)
+      break;
+    count += GetUniqueLsRanges(working_files, file).size();
+  }
+  return std::min<size_t>(count, g_config->xref.maxNum);
+}
+
 lsSymbolKind GetSymbolKind(QueryDatabase* db, SymbolIdx sym) {
   lsSymbolKind ret;
   if (sym.kind == SymbolKind::File)
@@ -313,6 +371,32 @@ optional<lsSymbolInformation> GetSymbolInfo(QueryDatabase* db,
   return nullopt;
 }
 
+namespace {
+
+// Appends the symbols in |def.all_symbols[lo, hi)| whose range contains
+// |position|. Subtrees whose ranges all end before |position|, or start after
+// it, are skipped using the implicit interval tree.
+void FindSymbolsContaining(const QueryFile::Def& def,
+                           Position position,
+                           size_t lo,
+                           size_t hi,
+                           std::vector<QueryId::SymbolRef>* symbols) {
+  while (lo < hi) {
+    size_t mid = lo + (hi - lo) / 2;
+    if (!(position < def.all_symbols_max_end[mid]))
+      return;
+    FindSymbolsContaining(def, position, lo, mid, symbols);
+    const QueryId::SymbolRef& sym = def.all_symbols[mid];
+    if (position < sym.range.start)
+      return;
+    if (position < sym.range.end)
+      symbols->push_back(sym);
+    lo = mid + 1;
+  }
+}
+
+}  // namespace
+
 std::vector<QueryId::SymbolRef> FindSymbolsAtLocation(WorkingFile* working_file,
                                                       QueryFile* file,
                                                       lsPosition position) {
@@ -328,9 +412,15 @@ std::vector<QueryId::SymbolRef> FindSymbolsAtLocation(WorkingFile* working_file,
       target_line = *index_line;
   }
 
-  for (const QueryId::SymbolRef& sym : file->def->all_symbols) {
-    if (sym.range.Contains(target_line, target_column))
-      symbols.push_back(sym);
+  const QueryFile::Def& def = *file->def;
+  if (def.all_symbols_max_end.size() == def.all_symbols.size()) {
+    FindSymbolsContaining(def, Position(target_line, target_column), 0,
+                          def.all_symbols.size(), &symbols);
+  } else {
+    for (const QueryId::SymbolRef& sym : def.all_symbols) {
+      if (sym.range.Contains(target_line, target_column))
+        symbols.push_back(sym);
+    }
   }
 
   // Order shorter ranges first, since they are more detailed/precise. This is
@@ -361,3 +451,74 @@ std::vector<QueryId::SymbolRef> FindSymbolsAtLocation(WorkingFile* working_file,
 
   return symbols;
 }
+
+TEST_SUITE("query_utils") {
+  TEST_CASE("FindSymbolsAtLocation") {
+    IndexFile file{AbsolutePath("foo.cc")};
+    IndexType* type = file.Resolve(file.ToTypeId(HashUsr("T")));
+    type->def.detailed_name = "T";
+    auto add_use = [&](int16_t start_line, int16_t start_column,
+                       int16_t end_line, int16_t end_column) {
+      type->uses.push_back(IndexLexicalRef(
+          Range(Position(start_line, start_column),
+                Position(end_line, end_column)),
+          type->id, SymbolKind::Type, Role::Reference));
+    };
+    add_use(0, 0, 20, 0);
+    add_use(1, 4, 1, 8);
+    add_use(1, 6, 3, 2);
+    add_use(2, 0, 2, 1);
+    add_use(5, 0, 5, 3);
+
+    QueryDatabase db;
+    IdMap id_map(&db, file.id_cache);
+    IndexUpdate update =
+        IndexUpdate::CreateDelta(nullptr, &id_map, nullptr, &file);
+    db.ApplyIndexUpdate(&update);
+    QueryFile* query_file = &db.files[id_map.primary_file.id];
+
+    auto find = [&](int line, int character) {
+      std::vector<Range> result;
+      for (QueryId::SymbolRef sym : FindSymbolsAtLocation(
+               nullptr, query_file, lsPosition(line, character)))
+        result.push_back(sym.range);
+      return result;
+    };
+    REQUIRE(find(1, 7).size() == 3);
+    REQUIRE(find(1, 7)[0] == Range(Position(1, 4), Position(1, 8)));
+    REQUIRE(find(2, 0).size() == 3);
+    REQUIRE(find(2, 0)[0] == Range(Position(2, 0), Position(2, 1)));
+    REQUIRE(find(3, 2).size() == 1);
+    REQUIRE(find(5, 3).size() == 1);
+    REQUIRE(find(20, 0).empty());
+  }
+
+  TEST_CASE("CountLsLocations") {
+    QueryDatabase db;
+    db.files.push_back(QueryFile(AbsolutePath("/a.cc")));
+    db.files.push_back(QueryFile(AbsolutePath("/b.cc")));
+    // b.cc is not indexed anymore.
+    db.files[1].def = nullopt;
+    WorkingFiles working_files;
+
+    Range a(Position(1, 0), Position(1, 3));
+    Range b(Position(2, 0), Position(2, 3));
+    auto ref = [](Range range, RawId file, Role role) {
+      return QueryId::LexicalRef(range, AnyId(), SymbolKind::Func, role,
+                                 QueryId::File(file));
+    };
+    // The duplicate and the reference into b.cc are not returned.
+    std::vector<QueryId::LexicalRef> refs = {
+        ref(b, 0, Role::Reference), ref(a, 0, Role::Reference),
+        ref(a, 0, Role::Call), ref(a, 1, Role::Reference)};
+
+    REQUIRE(GetLsLocations(&db, &working_files, refs).size() == 2);
+    REQUIRE(CountLsLocations(&db, &working_files, refs) == 2);
+
+    unsigned int max_num = g_config->xref.maxNum;
+    g_config->xref.maxNum = 1;
+    REQUIRE(GetLsLocations(&db, &working_files, refs).size() == 1);
+    REQUIRE(CountLsLocations(&db, &working_files, refs) == 1);
+    g_config->xref.maxNum = max_num;
+  }
+}
@@ -47,6 +47,11 @@ std::vector<lsLocation> GetLsLocations(
     QueryDatabase* db,
     WorkingFiles* working_files,
     const std::vector<QueryId::LexicalRef>& refs);
+// Same as GetLsLocations(db, working_files, refs).size(), without building
+// the URIs and locations.
+size_t CountLsLocations(QueryDatabase* db,
+                        WorkingFiles* working_files,
+                        const std::vector<QueryId::LexicalRef>& refs);
 // Returns a symbol. The symbol will have *NOT* have a location assigned.
 optional<lsSymbolInformation> GetSymbolInfo(QueryDatabase* db,
                                             WorkingFiles* working_files,
@@ -8,7 +8,7 @@
 
 Index_Request::Index_Request(
     const AbsolutePath& path,
-    const std::vector<std::string>& args,
+    const InternedArgs& args,
     bool is_interactive,
     const optional<std::string>& contents,
     const std::shared_ptr<ICacheManager>& cache_manager,
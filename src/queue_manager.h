@@ -16,15 +16,14 @@ struct Stdout_Request {
 
 struct Index_Request {
   AbsolutePath path;
-  // TODO: make |args| a string that is parsed lazily.
-  std::vector<std::string> args;
+  InternedArgs args;
   bool is_interactive;
   optional<std::string> contents;
   std::shared_ptr<ICacheManager> cache_manager;
   lsRequestId id;
 
   Index_Request(const AbsolutePath& path,
-                const std::vector<std::string>& args,
+                const InternedArgs& args,
                 bool is_interactive,
                 const optional<std::string>& contents,
                 const std::shared_ptr<ICacheManager>& cache_manager,
@@ -5,39 +5,49 @@
 #include "query.h"
 
 #include <optional.h>
+#include <sparsepp/spp.h>
 
+#include <map>
 #include <string>
-#include <unordered_map>
+#include <tuple>
 
-// Caches symbols for a single file for semantic highlighting to provide
-// relatively stable ids. Only supports xxx files at a time.
+// Assigns symbols ids which stay the same while cquery runs, so that clients
+// can keep highlighting a symbol the same way across files and reindexing.
+// Also keeps per-file state for the most recently highlighted files.
 struct SemanticHighlightSymbolCache {
   struct Entry {
-    SemanticHighlightSymbolCache* all_caches_ = nullptr;
-
     // The path this cache belongs to.
     std::string path;
-    // Detailed symbol name to stable id.
-    using TNameToId = std::unordered_map<std::string, int>;
-    TNameToId detailed_type_name_to_stable_id;
-    TNameToId detailed_func_name_to_stable_id;
-    TNameToId detailed_var_name_to_stable_id;
-
-    Entry(SemanticHighlightSymbolCache* all_caches, const std::string& path);
 
-    optional<int> TryGetStableId(SymbolKind kind,
-                                 const std::string& detailed_name);
-    int GetStableId(SymbolKind kind, const std::string& detailed_name);
+    // Ranges in the last publication for this file, by stable id, parent kind,
+    // kind, storage and role. Only kept if highlight.incremental is set.
+    using PublishedKey =
+        std::tuple<int, lsSymbolKind, lsSymbolKind, StorageClass, Role>;
+    optional<std::map<PublishedKey, std::vector<lsRange>>> published;
 
-    TNameToId* GetMapForSymbol_(SymbolKind kind);
+    explicit Entry(const std::string& path);
   };
 
   constexpr static int kCacheSize = 10;
+  // Upper bound on the number of stable ids which are remembered. When it is
+  // reached the table starts over, and symbols are given new ids.
+  constexpr static size_t kMaxStableIds = 1 << 20;
+
   LruCache<std::string, std::shared_ptr<Entry>> cache_;
-  uint32_t next_stable_id_ = 0;
   std::unique_ptr<GroupMatch> match_;
 
   SemanticHighlightSymbolCache();
   void Init();
   std::shared_ptr<Entry> GetCacheForFile(const std::string& path);
+
+  // Returns the stable id of the symbol of |kind| with |usr|.
+  int GetStableId(SymbolKind kind, Usr usr);
+
+ private:
+  spp::sparse_hash_map<Usr, int>* GetMapForSymbol(SymbolKind kind);
+
+  spp::sparse_hash_map<Usr, int> type_stable_ids_;
+  spp::sparse_hash_map<Usr, int> func_stable_ids_;
+  spp::sparse_hash_map<Usr, int> var_stable_ids_;
+  int next_stable_id_ = 0;
 };
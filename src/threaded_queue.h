@@ -6,6 +6,7 @@
 
 #include <algorithm>
 #include <atomic>
+#include <chrono>
 #include <condition_variable>
 #include <deque>
 #include <memory>
@@ -70,6 +71,17 @@ struct MultiQueueWaiter {
       cv.wait(l);
   }
 
+  // Like Wait, but also returns after |timeout| or on any notification, so
+  // that the caller can recheck conditions which do not depend on |queues|.
+  template <typename... BaseThreadQueue>
+  void WaitFor(std::chrono::milliseconds timeout, BaseThreadQueue... queues) {
+    assert(ValidateWaiter({queues...}));
+
+    MultiQueueLock<BaseThreadQueue...> l(queues...);
+    if (!HasState({queues...}))
+      cv.wait_for(l, timeout);
+  }
+
   std::condition_variable_any cv;
 };
 
@@ -166,6 +178,18 @@ struct ThreadedQueue : public BaseThreadQueue {
     return get_result(&queue_, &priority_);
   }
 
+  // Like TryDequeue, but only returns elements which were enqueued with
+  // |priority|.
+  optional<T> TryDequeuePriority() {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (priority_.empty())
+      return nullopt;
+    auto val = std::move(priority_.front());
+    priority_.pop_front();
+    --total_count_;
+    return std::move(val);
+  }
+
   template <typename Fn>
   void Iterate(Fn fn) {
     std::lock_guard<std::mutex> lock(mutex);
@@ -10,12 +10,15 @@
 #include <algorithm>
 #include <cassert>
 #include <cctype>
+#include <condition_variable>
 #include <cstring>
 #include <fstream>
 #include <functional>
+#include <mutex>
 #include <queue>
 #include <sstream>
 #include <string>
+#include <thread>
 #include <unordered_map>
 #include <sys/stat.h>
 
@@ -226,6 +229,77 @@ static void GetFilesInFolderHelper(
   }
 }
 
+std::vector<std::string> GetFilesInFolderParallel(
+    std::string folder,
+    bool add_folder_to_path,
+    const std::function<bool(const std::string&)>& enter_directory,
+    const std::function<bool(const std::string&)>& accept_file) {
+  EnsureEndsInSlash(folder);
+  size_t prefix_length = add_folder_to_path ? 0 : folder.size();
+
+  // Directories which still need to be read, as absolute paths ending in a
+  // slash. |busy| counts the workers which are reading a directory and may
+  // push more.
+  std::mutex mutex;
+  std::condition_variable cv;
+  std::vector<std::string> pending = {folder};
+  int busy = 0;
+  std::vector<std::vector<std::string>> results(
+      std::min(8u, std::max(1u, std::thread::hardware_concurrency())));
+
+  auto worker = [&](std::vector<std::string>* result) {
+    std::vector<std::string> subdirs;
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+      cv.wait(lock, [&] { return !pending.empty() || busy == 0; });
+      if (pending.empty())
+        break;
+      std::string dir = std::move(pending.back());
+      pending.pop_back();
+      ++busy;
+      lock.unlock();
+
+      bool ok = ReadDirectory(dir, [&](const char* name, bool is_dir,
+                                       bool is_symlink) {
+        // Skip all dot files except .cquery, see GetFilesInFolderHelper.
+        if (name[0] == '.' && strcmp(name, ".cquery") != 0)
+          return;
+        std::string path = dir + name;
+        if (is_dir) {
+          if (is_symlink)
+            return;
+          path += '/';
+          if (!enter_directory || enter_directory(path))
+            subdirs.push_back(std::move(path));
+        } else if (!accept_file || accept_file(path)) {
+          result->push_back(path.substr(prefix_length));
+        }
+      });
+      LOG_IF_S(WARNING, !ok) << "Unable to open directory " << dir;
+
+      lock.lock();
+      --busy;
+      for (std::string& subdir : subdirs)
+        pending.push_back(std::move(subdir));
+      subdirs.clear();
+      cv.notify_all();
+    }
+  };
+
+  std::vector<std::thread> threads;
+  for (size_t i = 1; i < results.size(); ++i)
+    threads.emplace_back(worker, &results[i]);
+  worker(&results[0]);
+  for (std::thread& thread : threads)
+    thread.join();
+
+  std::vector<std::string> files = std::move(results[0]);
+  for (size_t i = 1; i < results.size(); ++i)
+    files.insert(files.end(), results[i].begin(), results[i].end());
+  std::sort(files.begin(), files.end());
+  return files;
+}
+
 std::vector<std::string> GetFilesAndDirectoriesInFolder(std::string folder,
                                           bool recursive,
                                           bool add_folder_to_path) {
@@ -541,3 +615,35 @@ TEST_SUITE("StripFileType") {
     REQUIRE(StripFileType("foo/bar.cc") == "foo/bar");
   }
 }
+
+TEST_SUITE("GetFilesInFolderParallel") {
+  TEST_CASE("matches serial listing") {
+    optional<AbsolutePath> root = TryMakeTempDirectory();
+    REQUIRE(root);
+    std::string dir = root->path;
+    EnsureEndsInSlash(dir);
+    for (const char* subdir : {"a/b/c/", "a/skip/", "d/", ".git/"})
+      MakeDirectoryRecursive(AbsolutePath(dir + subdir, false));
+    for (const char* file : {"x.cc", "a/y.h", "a/b/c/z.cc", "a/skip/w.cc",
+                             "d/.cquery", "d/.hidden", ".git/config"})
+      WriteToFile(dir + file, "");
+
+    std::vector<std::string> serial =
+        GetFilesAndDirectoriesInFolder(dir, true /*recursive*/,
+                                       false /*add_folder_to_path*/);
+    std::sort(serial.begin(), serial.end());
+    REQUIRE(serial == std::vector<std::string>{"a/b/c/z.cc", "a/skip/w.cc",
+                                               "a/y.h", "d/.cquery", "x.cc"});
+    REQUIRE(GetFilesInFolderParallel(dir, false /*add_folder_to_path*/, {},
+                                     {}) == serial);
+
+    std::vector<std::string> filtered = GetFilesInFolderParallel(
+        dir, true /*add_folder_to_path*/,
+        [](const std::string& path) { return !EndsWith(path, "/skip/"); },
+        [](const std::string& path) { return EndsWith(path, ".cc"); });
+    REQUIRE(filtered ==
+            std::vector<std::string>{dir + "a/b/c/z.cc", dir + "x.cc"});
+
+    RemoveDirectoryRecursive(*root);
+  }
+}
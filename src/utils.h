@@ -84,6 +84,18 @@ void GetFilesAndDirectoriesInFolder(std::string folder,
                       bool add_folder_to_path,
                       const std::function<void(const std::string&)>& handler);
 
+// Recursively finds all files in |folder| using a pool of threads. Directories
+// for which |enter_directory| returns false are not entered, and only files
+// for which |accept_file| returns true are returned. Both callbacks receive
+// absolute paths (directories end in a slash), run concurrently and may be
+// empty. Dot files other than .cquery and symlinked directories are skipped
+// like in GetFilesAndDirectoriesInFolder. The result is sorted.
+std::vector<std::string> GetFilesInFolderParallel(
+    std::string folder,
+    bool add_folder_to_path,
+    const std::function<bool(const std::string&)>& enter_directory,
+    const std::function<bool(const std::string&)>& accept_file);
+
 // Ensures that |path| ends in a slash.
 void EnsureEndsInSlash(std::string& path);
 